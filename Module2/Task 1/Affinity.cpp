@@ -0,0 +1,270 @@
+#include "Affinity.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <omp.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace Affinity
+{
+    Policy currentPolicy = Policy::None;
+    std::vector<int> userCpus;
+
+    /**
+     * The CPUs this process may run on, with the NUMA node of each.
+     */
+    struct Topology
+    {
+        std::vector<int> cpus;
+        std::vector<int> nodeOf;
+        int nodes = 1;
+    };
+
+    /**
+     * Parse a cpu list such as "0-7,16-23" into the CPU numbers it names.
+     */
+    std::vector<int> parseCpuList(const std::string &list)
+    {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ',')) {
+            if(range.empty()) { continue; }
+            auto dash = range.find('-');
+            if(dash == std::string::npos) {
+                cpus.push_back(std::stoi(range));
+            } else {
+                int first = std::stoi(range.substr(0, dash));
+                int last = std::stoi(range.substr(dash + 1));
+                for(int cpu = first; cpu <= last; cpu++) { cpus.push_back(cpu); }
+            }
+        }
+        return cpus;
+    }
+
+    /**
+     * Read the node of every allowed CPU from sysfs. Without sysfs every
+     * CPU is treated as being on node 0.
+     */
+    Topology readTopology()
+    {
+        Topology topology;
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &allowed)) { topology.cpus.push_back(cpu); }
+        }
+        if(topology.cpus.empty()) { topology.cpus.push_back(0); }
+
+        topology.nodeOf.assign(topology.cpus.back() + 1, 0);
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string line;
+        std::getline(online, line);
+        for(int node : parseCpuList(line)) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string cpus;
+            std::getline(file, cpus);
+            for(int cpu : parseCpuList(cpus)) {
+                if(cpu < static_cast<int>(topology.nodeOf.size())) { topology.nodeOf[cpu] = node; }
+            }
+            topology.nodes = std::max(topology.nodes, node + 1);
+        }
+        return topology;
+    }
+
+    const Topology &topology()
+    {
+        static const Topology cached = readTopology();
+        return cached;
+    }
+
+    /**
+     * Order in which threads are given CPUs under the current policy.
+     */
+    std::vector<int> cpuOrder()
+    {
+        const Topology &topo = topology();
+        std::vector<std::vector<int>> byNode(topo.nodes);
+        for(int cpu : topo.cpus) { byNode[topo.nodeOf[cpu]].push_back(cpu); }
+
+        std::vector<int> order;
+        switch(currentPolicy)
+        {
+            case Policy::Explicit:
+                order = userCpus;
+                break;
+            case Policy::Scatter:
+                // One CPU from each node in turn.
+                for(size_t i = 0; order.size() < topo.cpus.size(); i++) {
+                    for(auto &cpus : byNode) {
+                        if(i < cpus.size()) { order.push_back(cpus[i]); }
+                    }
+                }
+                break;
+            case Policy::Compact:
+                for(auto &cpus : byNode) { order.insert(order.end(), cpus.begin(), cpus.end()); }
+                break;
+            default:
+                order = topo.cpus;
+                break;
+        }
+        if(order.empty()) { order = topo.cpus; }
+        return order;
+    }
+
+    std::vector<int> currentOrder = cpuOrder();
+
+    /**
+     * Select how threads are placed, e.g. from --affinity.
+     * @param policy: Placement policy.
+     * @param explicitCpus: CPUs to use, in thread order, for Policy::Explicit.
+     */
+    void setPolicy(Policy policy, const std::vector<int> &explicitCpus)
+    {
+        currentPolicy = policy;
+        userCpus = explicitCpus;
+        currentOrder = cpuOrder();
+    }
+
+    Policy policy() { return currentPolicy; }
+
+    /**
+     * Whether threads are pinned and pages placed by first touch.
+     */
+    bool enabled() { return currentPolicy != Policy::None; }
+
+    Policy parsePolicy(const std::string &name)
+    {
+        if(name == "none") { return Policy::None; }
+        if(name == "compact") { return Policy::Compact; }
+        if(name == "scatter") { return Policy::Scatter; }
+        if(name == "explicit") { return Policy::Explicit; }
+        throw std::invalid_argument("Unknown affinity policy: " + name);
+    }
+
+    int numNodes() { return topology().nodes; }
+
+    /**
+     * CPU that thread number thread of a team is bound to. Teams larger
+     * than the CPU list wrap around.
+     */
+    int cpuFor(int thread)
+    {
+        return currentOrder[thread % currentOrder.size()];
+    }
+
+    /**
+     * Bind the calling thread to one CPU.
+     * @return False if the kernel refused, e.g. the CPU is outside the cgroup.
+     */
+    bool pinCurrentThread(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+    ScopedPin::ScopedPin(int cpu)
+    {
+        CPU_ZERO(&saved);
+        if(sched_getaffinity(0, sizeof(saved), &saved) == 0) {
+            restore = pinCurrentThread(cpu);
+        }
+    }
+
+    ScopedPin::~ScopedPin()
+    {
+        if(restore) { sched_setaffinity(0, sizeof(saved), &saved); }
+    }
+
+    ScopedOmpPin::ScopedOmpPin(int numThreads)
+        : master(cpuFor(0)), numThreads(numThreads), saved(numThreads), restore(numThreads, 0)
+    {
+        // libgomp keeps its worker threads between parallel regions, so
+        // binding them once here holds for the regions that follow.
+        #pragma omp parallel default(none) shared(saved, restore) num_threads(numThreads)
+        {
+            const int thread = omp_get_thread_num();
+            if(thread != 0) {
+                CPU_ZERO(&saved[thread]);
+                if(sched_getaffinity(0, sizeof(cpu_set_t), &saved[thread]) == 0) {
+                    restore[thread] = pinCurrentThread(cpuFor(thread));
+                }
+            }
+        }
+    }
+
+    ScopedOmpPin::~ScopedOmpPin()
+    {
+        // The same team size gets the same workers back, in the same order.
+        #pragma omp parallel default(none) shared(saved, restore) num_threads(numThreads)
+        {
+            const int thread = omp_get_thread_num();
+            if(thread != 0 && restore[thread]) { sched_setaffinity(0, sizeof(cpu_set_t), &saved[thread]); }
+        }
+    }
+
+    /**
+     * Ask the kernel which node each sampled page of the buffer is on.
+     * move_pages with no target nodes only reports, it moves nothing.
+     */
+    Placement placement(const void *data, std::size_t bytes)
+    {
+        Placement result;
+        result.pagesOnNode.assign(numNodes(), 0);
+
+        const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t first = reinterpret_cast<uintptr_t>(data) / pageSize;
+        const uintptr_t last = (reinterpret_cast<uintptr_t>(data) + bytes + pageSize - 1) / pageSize;
+        const uintptr_t pages = last - first;
+        if(pages == 0) { return result; }
+
+        constexpr uintptr_t maxSamples = 4096;
+        const uintptr_t step = (pages + maxSamples - 1) / maxSamples;
+        std::vector<void*> addresses;
+        for(uintptr_t page = first; page < last; page += step) {
+            addresses.push_back(reinterpret_cast<void*>(page * pageSize));
+        }
+
+        std::vector<int> status(addresses.size(), 0);
+        if(syscall(SYS_move_pages, 0, addresses.size(), addresses.data(), nullptr, status.data(), 0) != 0) {
+            return result;
+        }
+
+        result.sampled = addresses.size();
+        for(int node : status) {
+            if(node >= 0 && node < static_cast<int>(result.pagesOnNode.size())) {
+                result.pagesOnNode[node]++;
+            } else {
+                result.unplaced++;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Print the share of the buffer's pages on each node.
+     * @param name: Label for the buffer, e.g. the matrix name.
+     */
+    void printPlacement(const std::string &name, const void *data, std::size_t bytes)
+    {
+        Placement pages = placement(data, bytes);
+        std::cout << name << " pages:";
+        if(pages.sampled == 0) {
+            std::cout << " placement unavailable" << std::endl;
+            return;
+        }
+        for(size_t node = 0; node < pages.pagesOnNode.size(); node++) {
+            std::cout << " node" << node << " " << 100 * pages.pagesOnNode[node] / pages.sampled << "%";
+        }
+        if(pages.unplaced != 0) { std::cout << ", untouched " << 100 * pages.unplaced / pages.sampled << "%"; }
+        std::cout << std::endl;
+    }
+};
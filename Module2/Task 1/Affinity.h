@@ -0,0 +1,92 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+/**
+ * Thread placement and NUMA helpers for the std::thread and OMP engines.
+ *
+ * Threads are bound with sched_setaffinity. The policy decides which CPU
+ * thread i of n gets:
+ *   Compact:  fill one NUMA node before moving to the next.
+ *   Scatter:  round-robin across nodes, so every node gets a share of threads.
+ *   Explicit: take CPUs from a user supplied list, in order.
+ * With Policy::None nothing is pinned and first-touch initialisation is
+ * left to the engines' defaults.
+ */
+namespace Affinity
+{
+    enum class Policy { None, Compact, Scatter, Explicit };
+
+    void setPolicy(Policy policy, const std::vector<int> &explicitCpus = {});
+    Policy policy();
+    bool enabled();
+    Policy parsePolicy(const std::string &name);
+    std::vector<int> parseCpuList(const std::string &list);
+
+    int numNodes();
+    int cpuFor(int thread);
+    bool pinCurrentThread(int cpu);
+
+    /**
+     * Pins the calling thread while in scope and restores its old mask after.
+     */
+    class ScopedPin
+    {
+    public:
+        explicit ScopedPin(int cpu);
+        ~ScopedPin();
+
+        ScopedPin(const ScopedPin&) = delete;
+        ScopedPin& operator=(const ScopedPin&) = delete;
+
+    private:
+        cpu_set_t saved;
+        bool restore = false;
+    };
+
+    /**
+     * Pins every thread of an OMP team of numThreads while in scope. The
+     * original mask of every thread, master and workers, is restored
+     * afterwards so serial code, and any team or policy used later, is not
+     * stuck on the old CPUs.
+     */
+    class ScopedOmpPin
+    {
+    public:
+        explicit ScopedOmpPin(int numThreads);
+        ~ScopedOmpPin();
+
+        ScopedOmpPin(const ScopedOmpPin&) = delete;
+        ScopedOmpPin& operator=(const ScopedOmpPin&) = delete;
+
+    private:
+        ScopedPin master;
+        int numThreads;
+        // Mask of worker thread i before pinning, and whether it was pinned.
+        std::vector<cpu_set_t> saved;
+        std::vector<char> restore;
+    };
+
+    /**
+     * Where the pages of a buffer live, from a sample of at most a few
+     * thousand pages. Pages that were never touched are counted as unplaced.
+     */
+    struct Placement
+    {
+        std::vector<uint64_t> pagesOnNode;
+        uint64_t unplaced = 0;
+        uint64_t sampled = 0;
+    };
+
+    Placement placement(const void *data, std::size_t bytes);
+    void printPlacement(const std::string &name, const void *data, std::size_t bytes);
+}
+
+
+#endif
@@ -0,0 +1,210 @@
+#include "Autotuner.h"
+#include "OMPParallelMultiplication.h"
+#include "ElementTypes.h"
+#include "CounterRandom.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace Autotuner
+{
+    std::string tuningFile = "omp_tuning.txt";
+
+    // (cpu model, size bucket, threads) -> best setting, loaded from tuningFile.
+    using Key = std::tuple<std::string, uint64_t, int>;
+    std::map<Key, Setting> settings;
+    bool loaded = false;
+
+    const char *scheduleNames[] = {"auto", "static", "dynamic", "guided"};
+
+    /**
+     * Use a different tuning file, e.g. from --tuning-file.
+     */
+    void setFile(const std::string &path)
+    {
+        tuningFile = path;
+        loaded = false;
+    }
+
+    const std::string &file() { return tuningFile; }
+
+    /**
+     * The CPU model from /proc/cpuinfo, so a file tuned on one machine is
+     * not applied on another.
+     */
+    const std::string &cpuModel()
+    {
+        static const std::string model = [] {
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            while(std::getline(cpuinfo, line)) {
+                if(line.rfind("model name", 0) == 0) {
+                    auto colon = line.find(':');
+                    return colon == std::string::npos ? std::string("unknown") : line.substr(colon + 2);
+                }
+            }
+            return std::string("unknown");
+        }();
+        return model;
+    }
+
+    /**
+     * Sizes are tuned per power of two, the bucket is the largest power of
+     * two not above size.
+     */
+    uint64_t sizeBucket(uint64_t size)
+    {
+        uint64_t bucket = 1;
+        while(bucket * 2 <= size) { bucket *= 2; }
+        return bucket;
+    }
+
+    const char *scheduleName(int scheduleType)
+    {
+        return (scheduleType >= 1 && scheduleType <= 3) ? scheduleNames[scheduleType] : scheduleNames[0];
+    }
+
+    int scheduleType(const std::string &name)
+    {
+        for(int type = 0; type < 4; type++) {
+            if(name == scheduleNames[type]) { return type; }
+        }
+        return 0;
+    }
+
+    /**
+     * Read the tuning file. Each line is tab separated:
+     * cpu model, size bucket, threads, schedule, chunk size, microseconds.
+     */
+    void load()
+    {
+        if(loaded) { return; }
+        loaded = true;
+        settings.clear();
+
+        std::ifstream in(tuningFile);
+        std::string line;
+        while(std::getline(in, line)) {
+            if(line.empty() || line[0] == '#') { continue; }
+            std::stringstream ss(line);
+            std::string model, bucket, threads, schedule, chunk, microseconds;
+            if(!std::getline(ss, model, '\t') || !std::getline(ss, bucket, '\t') || !std::getline(ss, threads, '\t')
+               || !std::getline(ss, schedule, '\t') || !std::getline(ss, chunk, '\t')) {
+                continue;
+            }
+            std::getline(ss, microseconds, '\t');
+
+            Setting setting;
+            setting.scheduleType = scheduleType(schedule);
+            setting.chunkSize = std::stoi(chunk);
+            setting.microseconds = microseconds.empty() ? 0 : std::stoull(microseconds);
+            settings[{model, std::stoull(bucket), std::stoi(threads)}] = setting;
+        }
+    }
+
+    /**
+     * Find the tuned setting for this machine, size bucket and thread count.
+     * @return False if the tuning file has no entry for them.
+     */
+    bool lookup(uint64_t size, int numThreads, Setting &setting)
+    {
+        load();
+        auto found = settings.find({cpuModel(), sizeBucket(size), numThreads});
+        if(found == settings.end()) { return false; }
+        setting = found->second;
+        return true;
+    }
+
+    /**
+     * Record a setting and rewrite the tuning file, keeping the other entries.
+     */
+    void store(uint64_t size, int numThreads, const Setting &setting)
+    {
+        load();
+        settings[{cpuModel(), sizeBucket(size), numThreads}] = setting;
+
+        std::ofstream out(tuningFile);
+        if(!out.is_open()) {
+            std::cerr << "Failed to open the tuning file for writing." << std::endl;
+            return;
+        }
+        out << "# cpu\tsize bucket\tthreads\tschedule\tchunk\tmicroseconds" << std::endl;
+        for(const auto &[key, value] : settings) {
+            out << std::get<0>(key) << "\t" << std::get<1>(key) << "\t" << std::get<2>(key) << "\t"
+                << scheduleName(value.scheduleType) << "\t" << value.chunkSize << "\t" << value.microseconds << std::endl;
+        }
+    }
+
+    /**
+     * Find the fastest schedule and chunk size for the naive OMP kernel with
+     * successive halving, and store it in the tuning file.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to tune for.
+     * @param budget: Total number of timed multiplications to spend.
+     * @return The best setting found.
+     */
+    template <typename T, typename Acc>
+    Setting tune(uint64_t size, int numThreads, int budget)
+    {
+        Matrix<T> v1(size), v2(size);
+        Matrix<Acc> v3(size);
+        OMPParallelMultiplication::randomMatrix(v1, CounterRandom::streamSeed(0), 1, 10, numThreads);
+        OMPParallelMultiplication::randomMatrix(v2, CounterRandom::streamSeed(1), 1, 10, numThreads);
+
+        // Static, dynamic and guided at power of two chunks up to one chunk
+        // per thread, plus auto which has no chunk size.
+        std::vector<Setting> survivors = {Setting{}};
+        const uint64_t maxChunk = std::max<uint64_t>(1, size / numThreads);
+        for(int type = 1; type <= 3; type++) {
+            for(uint64_t chunk = 1; chunk <= maxChunk; chunk *= 2) {
+                survivors.push_back({type, static_cast<int>(chunk), 0});
+            }
+        }
+
+        // Bring up the OMP team before anything is timed.
+        OMPParallelMultiplication::setSchedule(0, 0);
+        OMPParallelMultiplication::multiplyMatrix(v1, v2, v3, numThreads);
+
+        const int rounds = std::max(1, static_cast<int>(std::ceil(std::log2(survivors.size()))));
+        while(survivors.size() > 1) {
+            // Each round gets an equal share of the budget, split over fewer
+            // candidates every time, so the finalists are timed most often.
+            const int reps = std::max<int>(1, budget / (rounds * static_cast<int>(survivors.size())));
+            for(auto &candidate : survivors) {
+                OMPParallelMultiplication::setSchedule(candidate.scheduleType, candidate.chunkSize);
+                candidate.microseconds = UINT64_MAX;
+                for(int rep = 0; rep < reps; rep++) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    OMPParallelMultiplication::multiplyMatrix(v1, v2, v3, numThreads);
+                    auto end = std::chrono::high_resolution_clock::now();
+                    const uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+                    candidate.microseconds = std::min(candidate.microseconds, time);
+                }
+            }
+
+            std::stable_sort(survivors.begin(), survivors.end(), [](const Setting &a, const Setting &b) {
+                return a.microseconds < b.microseconds;
+            });
+            survivors.resize((survivors.size() + 1) / 2);
+        }
+
+        const Setting best = survivors.front();
+        std::cout << "Tuned size " << size << " with " << numThreads << " threads: "
+                  << scheduleName(best.scheduleType) << ", chunksize " << best.chunkSize
+                  << " (" << best.microseconds << " microseconds)" << std::endl;
+        store(size, numThreads, best);
+        return best;
+    }
+
+#define INSTANTIATE(name, T, Acc) \
+    template Setting tune<T, Acc>(uint64_t, int, int);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
@@ -0,0 +1,43 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Schedule and chunk size tuning for the OMP engine.
+ *
+ * tune() searches schedule x chunk size for one matrix size and thread
+ * count with successive halving: every candidate gets a short trial, the
+ * slower half is dropped, and the survivors get longer trials until one
+ * is left. The winner is saved to a tuning file keyed by (size bucket,
+ * thread count, CPU model), which OMPParallelMultiplication::run reads
+ * when asked for the tuned schedule.
+ */
+namespace Autotuner
+{
+    /**
+     * A schedule, numbered as in OMPParallelMultiplication::run, and its chunk size.
+     */
+    struct Setting
+    {
+        int scheduleType = 0;
+        int chunkSize = 0;
+        uint64_t microseconds = 0;
+    };
+
+    void setFile(const std::string &path);
+    const std::string &file();
+    const std::string &cpuModel();
+    uint64_t sizeBucket(uint64_t size);
+    const char *scheduleName(int scheduleType);
+
+    bool lookup(uint64_t size, int numThreads, Setting &setting);
+    void store(uint64_t size, int numThreads, const Setting &setting);
+
+    template <typename T = uint64_t, typename Acc = T>
+    Setting tune(uint64_t size, int numThreads, int budget);
+}
+
+
+#endif
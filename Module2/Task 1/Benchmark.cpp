@@ -0,0 +1,79 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Benchmark
+{
+    /**
+     * Linearly interpolated percentile of an ascending sample.
+     * @param sorted: Samples in ascending order.
+     * @param fraction: Percentile as a fraction, e.g. 0.95.
+     */
+    double percentile(const std::vector<uint64_t> &sorted, double fraction)
+    {
+        if(sorted.empty()) { return 0; }
+        const double position = fraction * static_cast<double>(sorted.size() - 1);
+        const size_t below = static_cast<size_t>(position);
+        const size_t above = std::min(below + 1, sorted.size() - 1);
+        const double weight = position - static_cast<double>(below);
+        return sorted[below] + weight * (static_cast<double>(sorted[above]) - sorted[below]);
+    }
+
+    /**
+     * Median, 5th/95th percentiles, mean and sample standard deviation.
+     * @param samples: Timings of the repetitions, in any order.
+     */
+    Summary summarize(std::vector<uint64_t> samples)
+    {
+        Summary summary;
+        summary.samples = samples.size();
+        if(samples.empty()) { return summary; }
+
+        std::sort(samples.begin(), samples.end());
+        summary.median = percentile(samples, 0.5);
+        summary.p5 = percentile(samples, 0.05);
+        summary.p95 = percentile(samples, 0.95);
+        summary.min = samples.front();
+        summary.max = samples.back();
+
+        double sum = 0;
+        for(uint64_t sample : samples) { sum += sample; }
+        summary.mean = sum / samples.size();
+
+        if(samples.size() > 1) {
+            double squares = 0;
+            for(uint64_t sample : samples) { squares += (sample - summary.mean) * (sample - summary.mean); }
+            summary.stddev = std::sqrt(squares / (samples.size() - 1));
+        }
+        return summary;
+    }
+
+    /**
+     * Throughput of a square multiply, counting a multiply and an add per inner step.
+     * @param size: Edge length of the matrices.
+     * @param microseconds: Time taken.
+     */
+    double gflops(uint64_t size, double microseconds)
+    {
+        return gflops(size, size, size, microseconds);
+    }
+
+    /**
+     * Rate of an M x K by K x N product, 2 * m * n * k operations.
+     */
+    double gflops(uint64_t m, uint64_t n, uint64_t k, double microseconds)
+    {
+        if(microseconds <= 0) { return 0; }
+        return 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k) / (microseconds * 1e3);
+    }
+
+    Summary measure(int warmup, int reps, const std::function<uint64_t(int)> &runOnce)
+    {
+        for(int i = 0; i < warmup; i++) { runOnce(-1 - i); }
+
+        std::vector<uint64_t> samples;
+        for(int rep = 0; rep < reps; rep++) { samples.push_back(runOnce(rep)); }
+        return summarize(samples);
+    }
+};
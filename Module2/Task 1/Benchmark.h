@@ -0,0 +1,42 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Repeated timing and summary statistics for the engines' run() functions.
+ */
+namespace Benchmark
+{
+    /**
+     * Statistics over the timed repetitions of one configuration, in microseconds.
+     */
+    struct Summary
+    {
+        uint64_t samples = 0;
+        double median = 0;
+        double p5 = 0;
+        double p95 = 0;
+        double mean = 0;
+        double stddev = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    double percentile(const std::vector<uint64_t> &sorted, double fraction);
+    Summary summarize(std::vector<uint64_t> samples);
+    double gflops(uint64_t size, double microseconds);
+    double gflops(uint64_t m, uint64_t n, uint64_t k, double microseconds);
+
+    /**
+     * Call runOnce warmup times without recording, then reps times recording
+     * what it returns. runOnce is given the repetition number, negative for
+     * warm-up runs.
+     */
+    Summary measure(int warmup, int reps, const std::function<uint64_t(int)> &runOnce);
+}
+
+
+#endif
@@ -0,0 +1,142 @@
+#include "CacheInfo.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <cmath>
+
+namespace CacheInfo
+{
+    // Used when sysfs is unavailable (non-Linux, containers without /sys).
+    constexpr CacheSizes defaultSizes{32 * 1024, 1024 * 1024, 8 * 1024 * 1024, 64};
+
+    /**
+     * Read the first line of a sysfs file.
+     * @param path: Path of the file to read.
+     * @return The line, or an empty string if the file could not be read.
+     */
+    std::string readLine(const std::string &path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    /**
+     * Parse a sysfs cache size such as "48K" or "2048K" into bytes.
+     */
+    uint64_t parseSize(const std::string &text)
+    {
+        if(text.empty()) { return 0; }
+        uint64_t value = std::stoull(text);
+        switch(text.back())
+        {
+            case 'K': return value * 1024;
+            case 'M': return value * 1024 * 1024;
+            case 'G': return value * 1024 * 1024 * 1024;
+            default: return value;
+        }
+    }
+
+    /**
+     * Count the CPUs in a sysfs cpu list such as "0-7,16-23".
+     */
+    uint64_t countCpus(const std::string &list)
+    {
+        uint64_t count = 0;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ',')) {
+            if(range.empty()) { continue; }
+            auto dash = range.find('-');
+            if(dash == std::string::npos) {
+                count++;
+            } else {
+                count += std::stoull(range.substr(dash + 1)) - std::stoull(range.substr(0, dash)) + 1;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Read the cache hierarchy of cpu0 from sysfs.
+     */
+    CacheSizes readSysfs()
+    {
+        CacheSizes sizes = defaultSizes;
+        const std::string base = "/sys/devices/system/cpu/cpu0/cache/index";
+
+        for(int index = 0; ; index++) {
+            const std::string dir = base + std::to_string(index) + "/";
+            std::string level = readLine(dir + "level");
+            if(level.empty()) { break; }
+
+            std::string type = readLine(dir + "type");
+            if(type == "Instruction") { continue; }
+
+            uint64_t size = parseSize(readLine(dir + "size"));
+            uint64_t sharing = countCpus(readLine(dir + "shared_cpu_list"));
+            if(size == 0) { continue; }
+            if(sharing > 1) { size /= sharing; }
+
+            std::string line = readLine(dir + "coherency_line_size");
+            if(!line.empty()) { sizes.lineSize = std::stoull(line); }
+
+            switch(std::stoi(level))
+            {
+                case 1: sizes.l1d = size; break;
+                case 2: sizes.l2 = size; break;
+                case 3: sizes.l3 = size; break;
+                default: break;
+            }
+        }
+        return sizes;
+    }
+
+    /**
+     * Cache sizes of the current machine. Read from sysfs on first call.
+     */
+    const CacheSizes &get()
+    {
+        static const CacheSizes sizes = readSysfs();
+        return sizes;
+    }
+
+    /**
+     * Square block edge so that one block each of A, B and C fits in the
+     * given cache level. Rounded down to a whole number of cache lines.
+     * @param level: Cache level to block for (1, 2 or 3).
+     * @param elementSize: Size in bytes of one matrix element.
+     * @return The block edge length in elements.
+     */
+    uint64_t blockSize(int level, std::size_t elementSize)
+    {
+        const CacheSizes &sizes = get();
+        uint64_t bytes;
+        switch(level)
+        {
+            case 1: bytes = sizes.l1d; break;
+            case 2: bytes = sizes.l2; break;
+            default: bytes = sizes.l3; break;
+        }
+
+        auto edge = static_cast<uint64_t>(std::sqrt(static_cast<double>(bytes) / (3.0 * elementSize)));
+        uint64_t perLine = sizes.lineSize / elementSize;
+        if(perLine == 0) { perLine = 1; }
+        edge = edge / perLine * perLine;
+        return edge < perLine ? perLine : edge;
+    }
+
+    /**
+     * Print the detected cache sizes to the console.
+     */
+    void print()
+    {
+        const CacheSizes &sizes = get();
+        std::cout << "L1d: " << sizes.l1d / 1024 << "K, L2: " << sizes.l2 / 1024
+                  << "K, L3 (per core): " << sizes.l3 / 1024 << "K, line: "
+                  << sizes.lineSize << "B" << std::endl;
+    }
+};
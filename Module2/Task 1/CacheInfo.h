@@ -0,0 +1,27 @@
+#ifndef CACHE_INFO_H
+#define CACHE_INFO_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace CacheInfo
+{
+    /**
+     * Data cache sizes, in bytes, for the CPU we are running on.
+     * Shared caches are reported as the share available to a single core.
+     */
+    struct CacheSizes
+    {
+        uint64_t l1d;
+        uint64_t l2;
+        uint64_t l3;
+        uint64_t lineSize;
+    };
+
+    const CacheSizes &get();
+    uint64_t blockSize(int level, std::size_t elementSize);
+    void print();
+}
+
+
+#endif
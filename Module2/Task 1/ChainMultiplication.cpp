@@ -0,0 +1,301 @@
+#include "ChainMultiplication.h"
+#include "Gemm.h"
+#include "Autotuner.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <omp.h>
+
+namespace ChainMultiplication
+{
+    CostModel currentModel;
+
+    /**
+     * Predicted microseconds for an m x k by k x n product. With no
+     * calibration every product runs at 1 GFLOP/s, which orders by flops.
+     */
+    double CostModel::predict(uint64_t m, uint64_t n, uint64_t k) const
+    {
+        const double flops = 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k);
+        if(rate.empty()) { return flops / 1e3; }
+
+        // The bucket itself, or the nearest measured one on a log scale.
+        const uint64_t bucket = Autotuner::sizeBucket(std::max<uint64_t>(1, std::min({m, n, k})));
+        auto above = rate.lower_bound(bucket);
+        auto nearest = above;
+        if(above == rate.end()) {
+            nearest = std::prev(above);
+        } else if(above->first != bucket && above != rate.begin()) {
+            auto below = std::prev(above);
+            nearest = static_cast<double>(above->first) / bucket < static_cast<double>(bucket) / below->first ? above : below;
+        }
+        return flops / (nearest->second * 1e3);
+    }
+
+    /**
+     * Fit the model to a results file written by main. Every row of the
+     * given type adds its flops and median time to the bucket of its
+     * smallest dimension; files from before the m, n, k columns use size.
+     * @param path: CSV results file.
+     * @param type: Row type to learn from, e.g. GEMM_OMP.
+     */
+    CostModel CostModel::fromCSV(const std::string &path, const std::string &type)
+    {
+        std::ifstream in(path);
+        if(!in.is_open()) { throw std::runtime_error("Cannot open " + path); }
+
+        auto split = [](const std::string &line) {
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while(std::getline(ss, field, ',')) { fields.push_back(field); }
+            return fields;
+        };
+
+        std::string line;
+        std::getline(in, line);
+        const std::vector<std::string> header = split(line);
+        auto column = [&](const std::string &name) {
+            auto found = std::find(header.begin(), header.end(), name);
+            return found == header.end() ? -1 : static_cast<int>(found - header.begin());
+        };
+        const int typeCol = column("type"), sizeCol = column("size"), timeCol = column("median_us");
+        const int mCol = column("m"), nCol = column("n"), kCol = column("k"), batchCol = column("batch");
+        if(typeCol < 0 || sizeCol < 0 || timeCol < 0) {
+            throw std::runtime_error(path + " is not a results file.");
+        }
+
+        std::map<uint64_t, std::pair<double, double>> totals;
+        while(std::getline(in, line)) {
+            const std::vector<std::string> fields = split(line);
+            if(static_cast<int>(fields.size()) < static_cast<int>(header.size()) || fields[typeCol] != type) { continue; }
+
+            auto number = [&](int col) { return col < 0 ? std::stoull(fields[sizeCol]) : std::stoull(fields[col]); };
+            const uint64_t m = number(mCol), n = number(nCol), k = number(kCol);
+            const uint64_t batch = batchCol < 0 ? 1 : std::stoull(fields[batchCol]);
+            const double time = std::stod(fields[timeCol]);
+            if(m == 0 || n == 0 || k == 0 || time <= 0) { continue; }
+
+            auto &total = totals[Autotuner::sizeBucket(std::min({m, n, k}))];
+            total.first += 2.0 * m * n * k * batch;
+            total.second += time;
+        }
+
+        CostModel model;
+        for(const auto &[bucket, total] : totals) { model.rate[bucket] = total.first / (total.second * 1e3); }
+        return model;
+    }
+
+    /**
+     * Use a calibrated model for every later run().
+     */
+    void setCostModel(const CostModel &model) { currentModel = model; }
+
+    const CostModel &costModel() { return currentModel; }
+
+    /**
+     * Find the cheapest order with the matrix chain dynamic programme: the
+     * best cost of i..j is the best over every split of the two sides plus
+     * the product that joins them.
+     * @param dims: n + 1 dimensions of an n matrix chain.
+     * @param model: Cost of each product.
+     */
+    Plan plan(const std::vector<uint64_t> &dims, const CostModel &model)
+    {
+        if(dims.size() < 2) { throw std::invalid_argument("A chain needs at least two dimensions."); }
+
+        Plan result;
+        result.dims = dims;
+        const uint64_t n = dims.size() - 1;
+        result.split.assign(n, std::vector<uint64_t>(n, 0));
+        result.cost.assign(n, std::vector<double>(n, 0));
+
+        for(uint64_t length = 2; length <= n; length++) {
+            for(uint64_t i = 0; i + length <= n; i++) {
+                const uint64_t j = i + length - 1;
+                result.cost[i][j] = std::numeric_limits<double>::infinity();
+                for(uint64_t k = i; k < j; k++) {
+                    const double cost = result.cost[i][k] + result.cost[k + 1][j]
+                                      + model.predict(dims[i], dims[j + 1], dims[k + 1]);
+                    if(cost < result.cost[i][j]) {
+                        result.cost[i][j] = cost;
+                        result.split[i][j] = k;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    std::string toString(const Plan &plan, uint64_t i, uint64_t j)
+    {
+        if(i == j) { return "A" + std::to_string(i); }
+        const uint64_t k = plan.split[i][j];
+        return "(" + toString(plan, i, k) + " " + toString(plan, k + 1, j) + ")";
+    }
+
+    /**
+     * The order as nested brackets, e.g. ((A0 A1) A2).
+     */
+    std::string Plan::toString() const { return ChainMultiplication::toString(*this, 0, dims.size() - 2); }
+
+    uint64_t flops(const Plan &plan, uint64_t i, uint64_t j)
+    {
+        if(i == j) { return 0; }
+        const uint64_t k = plan.split[i][j];
+        return flops(plan, i, k) + flops(plan, k + 1, j) + 2 * plan.dims[i] * plan.dims[k + 1] * plan.dims[j + 1];
+    }
+
+    /**
+     * Total flops of the planned order.
+     */
+    uint64_t flops(const Plan &plan) { return flops(plan, 0, plan.dims.size() - 2); }
+
+    /**
+     * Total flops of ((A0 A1) A2) ..., for comparison.
+     */
+    uint64_t leftToRightFlops(const std::vector<uint64_t> &dims)
+    {
+        uint64_t total = 0;
+        for(uint64_t i = 2; i < dims.size(); i++) { total += 2 * dims[0] * dims[i - 1] * dims[i]; }
+        return total;
+    }
+
+    /**
+     * Compute the product of matrices i..j of the chain on numThreads threads.
+     */
+    template <typename T>
+    Matrix<T> product(const Plan &plan, const std::vector<const Matrix<T>*> &chain, BufferPool<T> &pool,
+                      uint64_t i, uint64_t j, int numThreads)
+    {
+        const uint64_t k = plan.split[i][j];
+        const bool leftProduct = k > i, rightProduct = k + 1 < j;
+        Matrix<T> left, right;
+
+        if(leftProduct && rightProduct && numThreads > 1) {
+            // Both sides at once, threads shared out by predicted cost
+            const double share = plan.cost[i][k] / (plan.cost[i][k] + plan.cost[k + 1][j]);
+            const int leftThreads = std::clamp(static_cast<int>(std::lround(share * numThreads)), 1, numThreads - 1);
+            const int rightThreads = numThreads - leftThreads;
+            #pragma omp parallel sections default(none) shared(plan, chain, pool, left, right) \
+                firstprivate(i, j, k, leftThreads, rightThreads) num_threads(2)
+            {
+                #pragma omp section
+                left = product(plan, chain, pool, i, k, leftThreads);
+                #pragma omp section
+                right = product(plan, chain, pool, k + 1, j, rightThreads);
+            }
+        } else {
+            if(leftProduct) { left = product(plan, chain, pool, i, k, numThreads); }
+            if(rightProduct) { right = product(plan, chain, pool, k + 1, j, numThreads); }
+        }
+
+        const Matrix<T> &a = leftProduct ? left : *chain[i];
+        const Matrix<T> &b = rightProduct ? right : *chain[j];
+        Matrix<T> c = pool.acquire(a.rows(), b.cols());
+        Gemm::gemm(a.rows(), b.cols(), a.cols(), a.data(), a.stride(), b.data(), b.stride(), c.data(), c.stride(),
+                   Gemm::Backend::OMP, numThreads);
+
+        if(leftProduct) { pool.release(std::move(left)); }
+        if(rightProduct) { pool.release(std::move(right)); }
+        return c;
+    }
+
+    /**
+     * Multiply a chain in the planned order.
+     * @param plan: Order from plan(), for the dimensions of chain.
+     * @param chain: The matrices, in order.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param pool: Source of intermediate buffers; they are returned to it.
+     * @return The product, taken from the pool.
+     */
+    template <typename T>
+    Matrix<T> execute(const Plan &plan, const std::vector<const Matrix<T>*> &chain, int numThreads,
+                      BufferPool<T> &pool)
+    {
+        if(chain.size() + 1 != plan.dims.size()) { throw std::invalid_argument("Plan is for a different chain."); }
+        for(uint64_t i = 0; i < chain.size(); i++) {
+            if(chain[i]->rows() != plan.dims[i] || chain[i]->cols() != plan.dims[i + 1]) {
+                throw std::invalid_argument("Matrix " + std::to_string(i) + " does not match the plan.");
+            }
+        }
+        if(chain.size() == 1) {
+            Matrix<T> copy = pool.acquire(chain[0]->rows(), chain[0]->cols());
+            std::copy(chain[0]->data(), chain[0]->data() + chain[0]->rows() * chain[0]->stride(), copy.data());
+            return copy;
+        }
+
+        // Concurrent sub-products are nested parallel regions.
+        const int levels = omp_get_max_active_levels();
+        omp_set_max_active_levels(std::max(levels, static_cast<int>(chain.size())));
+        Matrix<T> result = product(plan, chain, pool, 0, chain.size() - 1, std::max(1, numThreads));
+        omp_set_max_active_levels(levels);
+        return result;
+    }
+
+    /**
+     * Run a chain of random matrices with the given dimensions. Values are
+     * in [-1, 1] so long chains stay well inside every accumulator type.
+     * @tparam Acc: Element type of the chain; intermediates are products too.
+     * @param dims: n + 1 dimensions of an n matrix chain.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @return Duration taken for planning and multiplying.
+     */
+    template <typename T, typename Acc>
+    uint64_t run(const std::vector<uint64_t> &dims, int numThreads)
+    {
+        // Buffers are kept between runs, as a pipeline repeating the chain would.
+        static BufferPool<Acc> pool;
+
+        // Initialize matrices
+        std::vector<Matrix<Acc>> matrices;
+        std::vector<const Matrix<Acc>*> chain;
+        for(uint64_t i = 0; i + 1 < dims.size(); i++) {
+            matrices.emplace_back(dims[i], dims[i + 1]);
+            CounterRandom::fillRows(matrices.back(), CounterRandom::streamSeed(i), -1, 1, 0, dims[i]);
+        }
+        for(const auto &matrix : matrices) { chain.push_back(&matrix); }
+
+        // Plan and multiply, measuring the time taken
+        PerfCounters::start();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const Plan order = plan(dims, currentModel);
+        Matrix<Acc> result = execute(order, chain, numThreads, pool);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
+
+        auto duration = std::chrono::duration_cast
+                        <std::chrono::microseconds>(end - start);
+
+        std::cout << "Chain Multiplication took: " << duration.count() << " microseconds, order "
+                  << order.toString() << ", " << flops(order) << " flops (" << leftToRightFlops(dims)
+                  << " left to right), pool hits " << pool.hits() << "/" << pool.hits() + pool.misses() << std::endl;
+
+        // Check the result, timed separately from the multiplication
+        Verification::verifyChain(chain, result);
+
+        pool.release(std::move(result));
+        return duration.count();
+    }
+
+    // Intermediates are products, so chains are built for the accumulator types.
+#define INSTANTIATE(Acc) \
+    template Matrix<Acc> execute<Acc>(const Plan &, const std::vector<const Matrix<Acc>*> &, int, BufferPool<Acc> &);
+    FOR_EACH_ACCUMULATOR_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+
+#define INSTANTIATE(name, T, Acc) \
+    template uint64_t run<T, Acc>(const std::vector<uint64_t> &, int);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
@@ -0,0 +1,109 @@
+#ifndef CHAIN_MULTIPLICATION_H
+#define CHAIN_MULTIPLICATION_H
+
+#include <iostream>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Matrix.h"
+
+/**
+ * Products of chains of matrices, A0 * A1 * ... * An-1, of mixed shapes.
+ *
+ * plan() picks the parenthesisation with the classic O(n^3) dynamic
+ * programme. Each product is costed by a CostModel fitted to benchmark
+ * results, not just by its flop count, because skinny products run at a
+ * lower rate than square ones. execute() walks the plan: the two sides of
+ * a product do not depend on each other, so when both are products they
+ * run at the same time on a share of the threads in proportion to their
+ * cost. Each product goes through Gemm::gemm. Intermediate results come
+ * from a BufferPool and go back to it once used.
+ */
+namespace ChainMultiplication
+{
+    /**
+     * Predicted time of a product from its shape: the GFLOP/s the
+     * benchmark measured for products whose smallest dimension falls in
+     * the same power-of-two bucket.
+     */
+    struct CostModel
+    {
+        // Smallest of m, n, k, rounded down to a power of two -> GFLOP/s.
+        std::map<uint64_t, double> rate;
+
+        double predict(uint64_t m, uint64_t n, uint64_t k) const;
+        static CostModel fromCSV(const std::string &path, const std::string &type);
+    };
+
+    void setCostModel(const CostModel &model);
+    const CostModel &costModel();
+
+    /**
+     * Order of evaluation for a chain with dimensions dims: matrix i is
+     * dims[i] x dims[i + 1].
+     */
+    struct Plan
+    {
+        std::vector<uint64_t> dims;
+        // split[i][j]: the product of matrices i..j is (i..split) * (split+1..j).
+        std::vector<std::vector<uint64_t>> split;
+        // cost[i][j]: predicted microseconds for the product of matrices i..j.
+        std::vector<std::vector<double>> cost;
+
+        std::string toString() const;
+    };
+
+    Plan plan(const std::vector<uint64_t> &dims, const CostModel &model);
+    uint64_t flops(const Plan &plan);
+    uint64_t leftToRightFlops(const std::vector<uint64_t> &dims);
+
+    /**
+     * Matrices of released intermediates, handed out again for the same
+     * shape. Safe to share between the threads of one execute().
+     */
+    template <typename T>
+    class BufferPool
+    {
+    public:
+        Matrix<T> acquire(uint64_t rows, uint64_t cols)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto &free = free_[{rows, cols}];
+            if(free.empty()) {
+                misses_++;
+                return Matrix<T>(rows, cols);
+            }
+            hits_++;
+            Matrix<T> matrix = std::move(free.back());
+            free.pop_back();
+            return matrix;
+        }
+
+        void release(Matrix<T> &&matrix)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_[{matrix.rows(), matrix.cols()}].push_back(std::move(matrix));
+        }
+
+        uint64_t hits() const { return hits_; }
+        uint64_t misses() const { return misses_; }
+
+    private:
+        std::mutex mutex_;
+        std::map<std::pair<uint64_t, uint64_t>, std::vector<Matrix<T>>> free_;
+        uint64_t hits_ = 0;
+        uint64_t misses_ = 0;
+    };
+
+    template <typename T>
+    Matrix<T> execute(const Plan &plan, const std::vector<const Matrix<T>*> &chain, int numThreads,
+                      BufferPool<T> &pool);
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(const std::vector<uint64_t> &dims, int numThreads);
+}
+
+
+#endif
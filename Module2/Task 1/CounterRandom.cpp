@@ -0,0 +1,22 @@
+#include "CounterRandom.h"
+
+#include <random>
+
+namespace CounterRandom
+{
+    uint64_t globalSeed = std::random_device{}();
+
+    /**
+     * Set the seed all matrices are derived from, e.g. from --seed.
+     */
+    void setSeed(uint64_t seed) { globalSeed = seed; }
+
+    uint64_t seed() { return globalSeed; }
+
+    /**
+     * Seed for one of the matrices of a run. Stream 0 is the first operand,
+     * stream 1 the second, so every engine multiplies the same inputs.
+     * @param stream: Index of the matrix within the run.
+     */
+    uint64_t streamSeed(uint64_t stream) { return mix(globalSeed + mix(stream)); }
+};
@@ -0,0 +1,93 @@
+#ifndef COUNTER_RANDOM_H
+#define COUNTER_RANDOM_H
+
+#include <cstdint>
+
+#include "Matrix.h"
+
+/**
+ * Counter-based random numbers for filling matrices.
+ *
+ * Every element is a pure function of (seed, row, col), hashed with the
+ * SplitMix64 finaliser. There is no generator state to share or copy, so
+ * any thread can fill any rows in any order and the matrix comes out the
+ * same, for every engine and every thread count.
+ */
+namespace CounterRandom
+{
+    void setSeed(uint64_t seed);
+    uint64_t seed();
+    uint64_t streamSeed(uint64_t stream);
+
+    /**
+     * SplitMix64 finaliser, a bijective 64-bit mix.
+     */
+    inline uint64_t mix(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * Random value in [low, high] for element (row, col) of the matrix seeded with seed.
+     */
+    inline int at(uint64_t seed, uint64_t row, uint64_t col, int low, int high)
+    {
+        const uint64_t bits = mix(seed ^ mix(row * 0xD1B54A32D192ED03ull + col));
+        const uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(high) - low + 1);
+        // Multiply-shift maps the top 32 bits onto the range without a divide.
+        return static_cast<int>(low + static_cast<int64_t>(((bits >> 32) * range) >> 32));
+    }
+
+    /**
+     * Fill rows [startRow, endRow) of the matrix.
+     * @param matrix: The matrix to be initialized.
+     * @param seed: Seed of this matrix, see streamSeed().
+     * @param low: Lower bound for random values.
+     * @param high: Upper bound for random values.
+     */
+    template <typename T>
+    void fillRows(Matrix<T> &matrix, uint64_t seed, int low, int high, uint64_t startRow, uint64_t endRow)
+    {
+        const uint64_t cols = matrix.cols();
+        for(uint64_t i = startRow; i < endRow; i++) {
+            T *row = matrix.row(i);
+            for(uint64_t j = 0; j < cols; j++) {
+                row[j] = static_cast<T>(at(seed, i, j, low, high));
+            }
+        }
+    }
+
+    /**
+     * Uniform value in [0, 1) for element (row, col), independent of at().
+     */
+    inline double unit(uint64_t seed, uint64_t row, uint64_t col)
+    {
+        const uint64_t bits = mix(~seed ^ mix(col * 0xD1B54A32D192ED03ull + row));
+        return static_cast<double>(bits >> 11) * 0x1.0p-53;
+    }
+
+    /**
+     * Fill rows [startRow, endRow) of a sparse matrix: each element is
+     * non-zero with probability density, with the value at() would give it.
+     * @param density: Expected fraction of non-zero elements.
+     * The other parameters are as for fillRows().
+     */
+    template <typename T>
+    void fillSparseRows(Matrix<T> &matrix, uint64_t seed, int low, int high, double density,
+                        uint64_t startRow, uint64_t endRow)
+    {
+        const uint64_t cols = matrix.cols();
+        for(uint64_t i = startRow; i < endRow; i++) {
+            T *row = matrix.row(i);
+            for(uint64_t j = 0; j < cols; j++) {
+                row[j] = unit(seed, i, j) < density ? static_cast<T>(at(seed, i, j, low, high)) : T{0};
+            }
+        }
+    }
+}
+
+
+#endif
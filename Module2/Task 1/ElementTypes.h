@@ -0,0 +1,36 @@
+#ifndef ELEMENT_TYPES_H
+#define ELEMENT_TYPES_H
+
+#include <cstdint>
+
+/**
+ * Storage / accumulator type pairs the multiplication engines are built for.
+ * Each entry is X(name, storage type, accumulator type). Narrow integer
+ * storage accumulates in int32_t so products of our 1..10 values cannot
+ * overflow at the sizes we run.
+ *
+ * Used to generate the explicit template instantiations in each engine and
+ * the --dtype dispatch table in main.cpp.
+ */
+#define FOR_EACH_ELEMENT_TYPE(X)     \
+    X("int8", int8_t, int32_t)       \
+    X("int16", int16_t, int32_t)     \
+    X("int32", int32_t, int32_t)     \
+    X("int64", int64_t, int64_t)     \
+    X("uint64", uint64_t, uint64_t)  \
+    X("float", float, float)         \
+    X("double", double, double)
+
+/**
+ * The distinct accumulator types above, each as X(type). For code that
+ * multiplies results again, like chains, where both operands are Acc.
+ */
+#define FOR_EACH_ACCUMULATOR_TYPE(X) \
+    X(int32_t)                       \
+    X(int64_t)                       \
+    X(uint64_t)                      \
+    X(float)                         \
+    X(double)
+
+
+#endif
@@ -0,0 +1,250 @@
+#include "Gemm.h"
+#include "CacheInfo.h"
+#include "ParallelMultiplication.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+#include "Affinity.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <omp.h>
+
+namespace Gemm
+{
+    // Products with fewer multiply-adds than this (64^3) finish faster on
+    // one thread than it takes to wake up the others.
+    constexpr uint64_t splitThreshold = 64 * 64 * 64;
+
+    /**
+     * How the M x N output is cut into tiles.
+     */
+    struct Tiling
+    {
+        uint64_t tileM;
+        uint64_t tileN;
+        uint64_t tilesM;
+        uint64_t tilesN;
+
+        uint64_t count() const { return tilesM * tilesN; }
+    };
+
+    /**
+     * Start from L2 sized tiles and halve the longer side until there are
+     * at least 4 tiles per thread, so skinny outputs are split along
+     * whichever dimension they have.
+     */
+    Tiling makeTiling(uint64_t M, uint64_t N, int numThreads, std::size_t elementSize)
+    {
+        const uint64_t edge = CacheInfo::blockSize(2, elementSize);
+        Tiling t{std::min(M, edge), std::min(N, edge), 0, 0};
+        while(true) {
+            t.tilesM = (M + t.tileM - 1) / t.tileM;
+            t.tilesN = (N + t.tileN - 1) / t.tileN;
+            if(t.count() >= 4 * static_cast<uint64_t>(numThreads)) { break; }
+            if(t.tileN >= t.tileM && t.tileN > 8) {
+                t.tileN /= 2;
+            } else if(t.tileM > 8) {
+                t.tileM /= 2;
+            } else {
+                break;
+            }
+        }
+        return t;
+    }
+
+    /**
+     * C[i0:i1, j0:j1] = A[i0:i1, :] * B[:, j0:j1] with an i-k-j loop,
+     * blocked over k so a panel of B stays in L1.
+     */
+    template <typename T, typename Acc>
+    void kernel(uint64_t K, const T *A, uint64_t lda, const T *B, uint64_t ldb, Acc *C, uint64_t ldc,
+                uint64_t i0, uint64_t i1, uint64_t j0, uint64_t j1)
+    {
+        static const uint64_t block = CacheInfo::blockSize(1, sizeof(Acc));
+
+        for(uint64_t i = i0; i < i1; i++) { std::fill(C + i * ldc + j0, C + i * ldc + j1, 0); }
+
+        for(uint64_t kk = 0; kk < K; kk += block) {
+            const uint64_t kEnd = std::min(kk + block, K);
+            for(uint64_t i = i0; i < i1; i++) {
+                const T *a = A + i * lda;
+                Acc *c = C + i * ldc;
+                for(uint64_t k = kk; k < kEnd; k++) {
+                    const Acc aik = a[k];
+                    const T *b = B + k * ldb;
+                    for(uint64_t j = j0; j < j1; j++) {
+                        c[j] += aik * static_cast<Acc>(b[j]);
+                    }
+                }
+            }
+        }
+    }
+
+    int resolveThreads(int numThreads)
+    {
+        if(numThreads > 0) { return numThreads; }
+        const unsigned int cpus = std::thread::hardware_concurrency();
+        return cpus > 0 ? static_cast<int>(cpus) : 1;
+    }
+
+    /**
+     * Run task(0) .. task(count - 1) on the backend's threads. Tasks are
+     * handed out one at a time, so uneven tiles balance out.
+     */
+    void forEach(uint64_t count, Backend backend, int numThreads, const std::function<void(uint64_t)> &task)
+    {
+        if(backend == Backend::Threads) {
+            ThreadPool &pool = ParallelMultiplication::getPool(numThreads, Affinity::enabled());
+            std::atomic<uint64_t> next{0};
+            pool.run([&](int) {
+                for(uint64_t i = next++; i < count; i = next++) { task(i); }
+            });
+        } else {
+            #pragma omp parallel for default(none) shared(task) firstprivate(count) num_threads(numThreads) schedule(dynamic)
+            for(uint64_t i = 0; i < count; i++) { task(i); }
+        }
+    }
+
+    /**
+     * C = A * B for an M x K matrix A and a K x N matrix B.
+     * @param M: Rows of A and C.
+     * @param N: Columns of B and C.
+     * @param K: Columns of A, rows of B.
+     * @param A: First operand, row-major.
+     * @param lda: Distance between rows of A, at least K.
+     * @param B: Second operand, row-major.
+     * @param ldb: Distance between rows of B, at least N.
+     * @param C: Receives the product, row-major. Overwritten.
+     * @param ldc: Distance between rows of C, at least N.
+     * @param backend: std::thread pool or OpenMP.
+     * @param numThreads: Number of threads, 0 for one per hardware thread.
+     */
+    template <typename T, typename Acc>
+    void gemm(uint64_t M, uint64_t N, uint64_t K,
+              const T *A, uint64_t lda, const T *B, uint64_t ldb, Acc *C, uint64_t ldc,
+              Backend backend, int numThreads)
+    {
+        if(M == 0 || N == 0) { return; }
+        numThreads = resolveThreads(numThreads);
+
+        if(numThreads == 1 || M * N * K < splitThreshold) {
+            kernel(K, A, lda, B, ldb, C, ldc, 0, M, 0, N);
+            return;
+        }
+
+        const Tiling t = makeTiling(M, N, numThreads, sizeof(Acc));
+        forEach(t.count(), backend, numThreads, [&](uint64_t tile) {
+            const uint64_t i0 = (tile / t.tilesN) * t.tileM;
+            const uint64_t j0 = (tile % t.tilesN) * t.tileN;
+            kernel(K, A, lda, B, ldb, C, ldc, i0, std::min(i0 + t.tileM, M), j0, std::min(j0 + t.tileN, N));
+        });
+    }
+
+    /**
+     * C[b] = A[b] * B[b] for every b < batch, all of the same shape.
+     * @param batch: Number of products.
+     * @param A: batch pointers to the first operands.
+     * @param B: batch pointers to the second operands.
+     * @param C: batch pointers to the results.
+     * The other parameters are as for gemm().
+     */
+    template <typename T, typename Acc>
+    void gemmBatched(uint64_t batch, uint64_t M, uint64_t N, uint64_t K,
+                     const T *const *A, uint64_t lda, const T *const *B, uint64_t ldb,
+                     Acc *const *C, uint64_t ldc, Backend backend, int numThreads)
+    {
+        numThreads = resolveThreads(numThreads);
+
+        // Small products, or enough of them to keep every thread busy, run
+        // whole on one thread each. Otherwise split every product instead.
+        if(M * N * K < splitThreshold || batch >= 4 * static_cast<uint64_t>(numThreads)) {
+            forEach(batch, backend, numThreads, [&](uint64_t b) {
+                kernel(K, A[b], lda, B[b], ldb, C[b], ldc, 0, M, 0, N);
+            });
+        } else {
+            for(uint64_t b = 0; b < batch; b++) {
+                gemm(M, N, K, A[b], lda, B[b], ldb, C[b], ldc, backend, numThreads);
+            }
+        }
+    }
+
+    /**
+     * Run a batch of rectangular multiplications on random matrices.
+     * @tparam T: Storage type of the input matrices.
+     * @tparam Acc: Accumulator and result type.
+     * @param M: Rows of A and C.
+     * @param N: Columns of B and C.
+     * @param K: Columns of A, rows of B.
+     * @param batch: Number of independent products, 1 for a single gemm().
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param backend: std::thread pool or OpenMP.
+     * @return Duration taken for the multiplication operation.
+     */
+    template <typename T, typename Acc>
+    uint64_t run(uint64_t M, uint64_t N, uint64_t K, uint64_t batch, int numThreads, Backend backend)
+    {
+        // Initialize matrices, each product from its own pair of seeds
+        std::vector<Matrix<T>> a, b;
+        std::vector<Matrix<Acc>> c;
+        std::vector<const T*> aPtr, bPtr;
+        std::vector<Acc*> cPtr;
+        for(uint64_t i = 0; i < batch; i++) {
+            a.emplace_back(M, K);
+            b.emplace_back(K, N);
+            c.emplace_back(M, N);
+            CounterRandom::fillRows(a.back(), CounterRandom::streamSeed(2 * i), 1, 10, 0, M);
+            CounterRandom::fillRows(b.back(), CounterRandom::streamSeed(2 * i + 1), 1, 10, 0, K);
+        }
+        for(uint64_t i = 0; i < batch; i++) {
+            aPtr.push_back(a[i].data());
+            bPtr.push_back(b[i].data());
+            cPtr.push_back(c[i].data());
+        }
+
+        // Perform matrix multiplication and measure the time taken
+        PerfCounters::start();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if(batch == 1) {
+            gemm(M, N, K, aPtr[0], a[0].stride(), bPtr[0], b[0].stride(), cPtr[0], c[0].stride(), backend, numThreads);
+        } else if(batch > 1) {
+            gemmBatched(batch, M, N, K, aPtr.data(), a[0].stride(), bPtr.data(), b[0].stride(),
+                        cPtr.data(), c[0].stride(), backend, numThreads);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
+
+        auto duration = std::chrono::duration_cast
+                        <std::chrono::microseconds>(end - start);
+
+        std::cout << (backend == Backend::Threads ? "GEMM (threads) took: " : "GEMM (OMP) took: ") << duration.count()
+                  << " microseconds, for " << batch << " x " << M << "x" << N << "x" << K << std::endl;
+
+        // Check every result, timed separately from the multiplication.
+        // The run's verification time is that of the whole batch.
+        uint64_t verifyTime = 0;
+        for(uint64_t i = 0; i < batch; i++) {
+            verifyTime += Verification::verify(a[i], b[i], c[i]);
+        }
+        Verification::setLastMicroseconds(verifyTime);
+
+        return duration.count();
+    }
+
+#define INSTANTIATE(name, T, Acc) \
+    template void gemm<T, Acc>(uint64_t, uint64_t, uint64_t, const T *, uint64_t, const T *, uint64_t, \
+                               Acc *, uint64_t, Backend, int); \
+    template void gemmBatched<T, Acc>(uint64_t, uint64_t, uint64_t, uint64_t, const T *const *, uint64_t, \
+                                      const T *const *, uint64_t, Acc *const *, uint64_t, Backend, int); \
+    template uint64_t run<T, Acc>(uint64_t, uint64_t, uint64_t, uint64_t, int, Backend);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
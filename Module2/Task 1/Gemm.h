@@ -0,0 +1,43 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <cstdint>
+
+#include "Matrix.h"
+
+/**
+ * General rectangular multiplication, C = A * B, on raw row-major buffers.
+ *
+ * A is M x K with leading dimension lda, B is K x N with ldb, C is M x N
+ * with ldc; the leading dimension is the distance between rows, in
+ * elements. The output is cut into tiles that are shared between threads,
+ * so skinny shapes (small M or small N) still use every thread.
+ *
+ * gemmBatched multiplies many independent problems of the same shape.
+ * Problems too small to split are spread across threads whole; large ones
+ * run one after the other, each over all threads.
+ */
+namespace Gemm
+{
+    /**
+     * Which engine's threads do the work: the std::thread pool of
+     * ParallelMultiplication, or an OpenMP team.
+     */
+    enum class Backend { Threads, OMP };
+
+    template <typename T, typename Acc>
+    void gemm(uint64_t M, uint64_t N, uint64_t K,
+              const T *A, uint64_t lda, const T *B, uint64_t ldb, Acc *C, uint64_t ldc,
+              Backend backend = Backend::OMP, int numThreads = 0);
+
+    template <typename T, typename Acc>
+    void gemmBatched(uint64_t batch, uint64_t M, uint64_t N, uint64_t K,
+                     const T *const *A, uint64_t lda, const T *const *B, uint64_t ldb,
+                     Acc *const *C, uint64_t ldc, Backend backend = Backend::OMP, int numThreads = 0);
+
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(uint64_t M, uint64_t N, uint64_t K, uint64_t batch, int numThreads, Backend backend);
+}
+
+
+#endif
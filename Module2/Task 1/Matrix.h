@@ -0,0 +1,98 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+/**
+ * A matrix stored as a single contiguous, row-major buffer.
+ *
+ * The buffer is aligned to a 64 byte cache line and every row is padded
+ * out to `stride` elements, so each row also starts on a cache line.
+ * Element (row, col) lives at data()[row * stride() + col].
+ */
+template <typename T>
+class Matrix
+{
+public:
+    static constexpr std::size_t alignment = 64;
+
+    Matrix() = default;
+
+    /**
+     * Allocate a rows x cols matrix. The contents are left uninitialised.
+     * @param rows: Number of rows.
+     * @param cols: Number of columns.
+     */
+    Matrix(uint64_t rows, uint64_t cols)
+        : rows_(rows), cols_(cols), stride_(paddedStride(cols))
+    {
+        std::size_t bytes = rows_ * stride_ * sizeof(T);
+        // aligned_alloc requires the size to be a multiple of the alignment.
+        bytes = (bytes + alignment - 1) / alignment * alignment;
+        if(bytes == 0) { return; }
+        data_ = static_cast<T*>(std::aligned_alloc(alignment, bytes));
+        if(data_ == nullptr) { throw std::bad_alloc(); }
+    }
+
+    /**
+     * Allocate a square size x size matrix.
+     * @param size: Number of rows and columns.
+     */
+    explicit Matrix(uint64_t size) : Matrix(size, size) {}
+
+    ~Matrix() { std::free(data_); }
+
+    Matrix(const Matrix&) = delete;
+    Matrix& operator=(const Matrix&) = delete;
+
+    Matrix(Matrix&& other) noexcept
+        : data_(other.data_), rows_(other.rows_), cols_(other.cols_), stride_(other.stride_)
+    {
+        other.data_ = nullptr;
+        other.rows_ = other.cols_ = other.stride_ = 0;
+    }
+
+    Matrix& operator=(Matrix&& other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(stride_, other.stride_);
+        return *this;
+    }
+
+    T &operator()(uint64_t row, uint64_t col) { return data_[row * stride_ + col]; }
+    const T &operator()(uint64_t row, uint64_t col) const { return data_[row * stride_ + col]; }
+
+    T *row(uint64_t row) { return data_ + row * stride_; }
+    const T *row(uint64_t row) const { return data_ + row * stride_; }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+
+    uint64_t rows() const { return rows_; }
+    uint64_t cols() const { return cols_; }
+    uint64_t stride() const { return stride_; }
+
+private:
+    /**
+     * Round the column count up so a row fills a whole number of cache lines.
+     */
+    static uint64_t paddedStride(uint64_t cols)
+    {
+        if(alignment % sizeof(T) != 0) { return cols; }
+        const uint64_t perLine = alignment / sizeof(T);
+        return (cols + perLine - 1) / perLine * perLine;
+    }
+
+    T *data_ = nullptr;
+    uint64_t rows_ = 0;
+    uint64_t cols_ = 0;
+    uint64_t stride_ = 0;
+};
+
+
+#endif
@@ -0,0 +1,240 @@
+#include "MatrixFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace MatrixFile
+{
+    [[noreturn]] void fail(const std::string &what, const std::string &path)
+    {
+        throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+    }
+
+    uint64_t roundUp(uint64_t value, uint64_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    /**
+     * Header for a new file. Tile rows are padded to whole cache lines and
+     * tiles to whole pages.
+     */
+    Header makeHeader(const char *dtype, uint64_t elementSize, uint64_t rows, uint64_t cols, uint64_t tileSize)
+    {
+        if(tileSize == 0) { throw std::invalid_argument("Tile size must be positive."); }
+
+        Header header{};
+        std::memcpy(header.magic, magicBytes, sizeof(header.magic));
+        std::memcpy(header.dtype, dtype, std::min(std::strlen(dtype), sizeof(header.dtype)));
+        header.elementSize = elementSize;
+        header.rows = rows;
+        header.cols = cols;
+        header.tileSize = tileSize;
+        header.stride = 64 % elementSize == 0 ? roundUp(tileSize, 64 / elementSize) : tileSize;
+        header.tileBytes = roundUp(tileSize * header.stride * elementSize, pageSize);
+        header.dataOffset = roundUp(sizeof(Header), pageSize);
+        return header;
+    }
+
+    uint64_t fileBytes(const Header &header)
+    {
+        const uint64_t tiles = ((header.rows + header.tileSize - 1) / header.tileSize)
+                             * ((header.cols + header.tileSize - 1) / header.tileSize);
+        return header.dataOffset + tiles * header.tileBytes;
+    }
+
+    /**
+     * Whether the layout fields of a header are consistent, so every tile
+     * lies inside its tileBytes and every element is aligned. Products are
+     * checked for overflow, a corrupt header could otherwise wrap around
+     * to a small file size.
+     */
+    bool consistent(const Header &header)
+    {
+        const uint64_t e = header.elementSize;
+        if(e != 1 && e != 2 && e != 4 && e != 8) { return false; }
+        if(header.tileSize == 0 || header.stride < header.tileSize) { return false; }
+        if(header.dataOffset < sizeof(Header) || header.dataOffset % pageSize != 0) { return false; }
+        if(header.tileBytes == 0 || header.tileBytes % pageSize != 0) { return false; }
+
+        uint64_t tileElements, tileBytes, tiles, dataBytes, total;
+        const uint64_t tileRows = header.rows / header.tileSize + (header.rows % header.tileSize != 0);
+        const uint64_t tileCols = header.cols / header.tileSize + (header.cols % header.tileSize != 0);
+        if(__builtin_mul_overflow(header.tileSize, header.stride, &tileElements)
+           || __builtin_mul_overflow(tileElements, e, &tileBytes)
+           || __builtin_mul_overflow(tileRows, tileCols, &tiles)
+           || __builtin_mul_overflow(tiles, header.tileBytes, &dataBytes)
+           || __builtin_add_overflow(dataBytes, header.dataOffset, &total)) {
+            return false;
+        }
+        return tileBytes <= header.tileBytes;
+    }
+
+    void validate(const Header &header, uint64_t bytes, const std::string &path)
+    {
+        if(bytes < sizeof(Header) || std::memcmp(header.magic, magicBytes, sizeof(magicBytes)) != 0) {
+            throw std::runtime_error(path + " is not a matrix file.");
+        }
+        if(!consistent(header) || bytes < fileBytes(header)) {
+            throw std::runtime_error(path + " is truncated or has a corrupt header.");
+        }
+    }
+
+    /**
+     * Read just the header, e.g. to find the element type before mapping.
+     */
+    Header readHeader(const std::string &path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) { fail("Cannot open", path); }
+
+        Header header{};
+        const ssize_t got = ::pread(fd, &header, sizeof(header), 0);
+        struct stat info{};
+        ::fstat(fd, &info);
+        ::close(fd);
+        if(got != static_cast<ssize_t>(sizeof(header))) {
+            throw std::runtime_error(path + " is not a matrix file.");
+        }
+        validate(header, info.st_size, path);
+        return header;
+    }
+
+    /**
+     * Write the header and size the file. The tiles are left as a hole that
+     * reads back as zeros, so creating a 60GB file takes no time or disk.
+     */
+    void create(const std::string &path, const Header &header)
+    {
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) { fail("Cannot create", path); }
+
+        if(::pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+           || ::ftruncate(fd, fileBytes(header)) != 0) {
+            const int error = errno;
+            ::close(fd);
+            errno = error;
+            fail("Cannot write", path);
+        }
+        ::close(fd);
+    }
+
+    /**
+     * Map the whole file, shared, so writes land in the file.
+     */
+    Mapping::Mapping(const std::string &path, bool writable)
+    {
+        const int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if(fd < 0) { fail("Cannot open", path); }
+
+        struct stat info{};
+        if(::fstat(fd, &info) != 0) {
+            ::close(fd);
+            fail("Cannot stat", path);
+        }
+        bytes_ = info.st_size;
+        if(bytes_ < sizeof(Header)) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a matrix file.");
+        }
+
+        void *data = ::mmap(nullptr, bytes_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if(data == MAP_FAILED) {
+            const int error = errno;
+            ::close(fd);
+            errno = error;
+            fail("Cannot map", path);
+        }
+        data_ = static_cast<char*>(data);
+        fd_ = fd;
+
+        try {
+            validate(header(), bytes_, path);
+        } catch(...) {
+            ::munmap(data_, bytes_);
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    Mapping::~Mapping()
+    {
+        if(data_ != nullptr) { ::munmap(data_, bytes_); }
+        if(fd_ >= 0) { ::close(fd_); }
+    }
+
+    Mapping::Mapping(Mapping&& other) noexcept : data_(other.data_), bytes_(other.bytes_), fd_(other.fd_)
+    {
+        other.data_ = nullptr;
+        other.bytes_ = 0;
+        other.fd_ = -1;
+    }
+
+    Mapping& Mapping::operator=(Mapping&& other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(bytes_, other.bytes_);
+        std::swap(fd_, other.fd_);
+        return *this;
+    }
+
+    /**
+     * Advice is only a hint, so failures are ignored.
+     */
+    void Mapping::advise(uint64_t offset, uint64_t bytes, int advice) const
+    {
+        ::madvise(data_ + offset, bytes, advice);
+    }
+
+    void Mapping::sync(uint64_t offset, uint64_t bytes) const
+    {
+        ::msync(data_ + offset, bytes, MS_ASYNC);
+    }
+
+    void Mapping::evict() const
+    {
+        ::msync(data_, bytes_, MS_SYNC);
+        ::madvise(data_, bytes_, MADV_DONTNEED);
+        ::posix_fadvise(fd_, 0, bytes_, POSIX_FADV_DONTNEED);
+    }
+
+    /**
+     * Save a matrix held in memory to a tiled file.
+     * @param path: File to create.
+     * @param matrix: The matrix to save.
+     * @param tileSize: Edge length of the tiles.
+     */
+    template <typename T>
+    void write(const std::string &path, const Matrix<T> &matrix, uint64_t tileSize)
+    {
+        auto file = MappedMatrix<T>::create(path, matrix.rows(), matrix.cols(), tileSize);
+        for(uint64_t i = 0; i < matrix.rows(); i++) {
+            for(uint64_t j = 0; j < matrix.cols(); j++) { file.at(i, j) = matrix(i, j); }
+        }
+    }
+
+    /**
+     * Load a whole tiled file into memory.
+     */
+    template <typename T>
+    Matrix<T> read(const std::string &path)
+    {
+        MappedMatrix<T> file(path);
+        Matrix<T> matrix(file.rows(), file.cols());
+        for(uint64_t i = 0; i < matrix.rows(); i++) {
+            for(uint64_t j = 0; j < matrix.cols(); j++) { matrix(i, j) = file.at(i, j); }
+        }
+        return matrix;
+    }
+
+    // Every accumulator type is also a storage type, so this covers result files too.
+#define INSTANTIATE(name, T, Acc) \
+    template void write<T>(const std::string &, const Matrix<T> &, uint64_t); \
+    template Matrix<T> read<T>(const std::string &);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
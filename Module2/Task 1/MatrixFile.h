@@ -0,0 +1,180 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "ElementTypes.h"
+#include "Matrix.h"
+
+/**
+ * Binary matrix files, used in place through mmap.
+ *
+ * A file is one page holding the Header, then the matrix cut into square
+ * tiles of tileSize x tileSize, in row-major tile order. Each tile is
+ * row-major with `stride` elements between its rows and starts on a page
+ * boundary, so one tile can be paged in, advised or dropped on its own.
+ * Tiles on the right and bottom edges are padded with zeros.
+ */
+namespace MatrixFile
+{
+    constexpr char magicBytes[8] = {'M', 'A', 'T', 'R', 'I', 'X', '0', '1'};
+    constexpr uint64_t pageSize = 4096;
+
+    /**
+     * The first bytes of every file. Sizes are in elements unless named bytes.
+     */
+    struct Header
+    {
+        char magic[8];
+        char dtype[8];
+        uint64_t elementSize;
+        uint64_t rows;
+        uint64_t cols;
+        uint64_t tileSize;
+        uint64_t stride;
+        uint64_t tileBytes;
+        uint64_t dataOffset;
+    };
+
+    /**
+     * The --dtype name of an element type, as stored in the header.
+     */
+    template <typename T>
+    const char *dtypeName()
+    {
+#define DTYPE_NAME(name, U, Acc) if constexpr(std::is_same_v<T, U>) { return name; } else
+        FOR_EACH_ELEMENT_TYPE(DTYPE_NAME) { return "unknown"; }
+#undef DTYPE_NAME
+    }
+
+    Header makeHeader(const char *dtype, uint64_t elementSize, uint64_t rows, uint64_t cols, uint64_t tileSize);
+    Header readHeader(const std::string &path);
+
+    /**
+     * A whole file mapped into memory, unmapped on destruction.
+     */
+    class Mapping
+    {
+    public:
+        Mapping() = default;
+        Mapping(const std::string &path, bool writable);
+        ~Mapping();
+
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        Mapping(Mapping&& other) noexcept;
+        Mapping& operator=(Mapping&& other) noexcept;
+
+        const Header &header() const { return *reinterpret_cast<const Header*>(data_); }
+        char *data() const { return data_; }
+
+        void advise(uint64_t offset, uint64_t bytes, int advice) const;
+        void sync(uint64_t offset, uint64_t bytes) const;
+        void evict() const;
+
+    private:
+        char *data_ = nullptr;
+        uint64_t bytes_ = 0;
+        int fd_ = -1;
+    };
+
+    void create(const std::string &path, const Header &header);
+
+    /**
+     * A tiled matrix file of element type T, mapped with no copy: tile()
+     * points straight into the page cache.
+     */
+    template <typename T>
+    class MappedMatrix
+    {
+    public:
+        /**
+         * Map an existing file. Throws if it holds a different element type.
+         * @param path: File to map.
+         * @param writable: Map read-write, so changes go back to the file.
+         */
+        explicit MappedMatrix(const std::string &path, bool writable = false) : mapping_(path, writable)
+        {
+            if(std::strncmp(header().dtype, dtypeName<T>(), sizeof(header().dtype)) != 0) {
+                throw std::invalid_argument(path + " holds " + std::string(header().dtype, strnlen(header().dtype, 8))
+                                            + " elements, not " + dtypeName<T>());
+            }
+            if(header().elementSize != sizeof(T)) {
+                throw std::runtime_error(path + " is truncated or has a corrupt header.");
+            }
+        }
+
+        /**
+         * Create a zero-filled rows x cols file and map it read-write.
+         * @param tileSize: Edge length of the tiles.
+         */
+        static MappedMatrix create(const std::string &path, uint64_t rows, uint64_t cols, uint64_t tileSize)
+        {
+            MatrixFile::create(path, makeHeader(dtypeName<T>(), sizeof(T), rows, cols, tileSize));
+            return MappedMatrix(path, true);
+        }
+
+        const Header &header() const { return mapping_.header(); }
+        uint64_t rows() const { return header().rows; }
+        uint64_t cols() const { return header().cols; }
+        uint64_t tileSize() const { return header().tileSize; }
+        uint64_t stride() const { return header().stride; }
+        uint64_t tileRows() const { return (rows() + tileSize() - 1) / tileSize(); }
+        uint64_t tileCols() const { return (cols() + tileSize() - 1) / tileSize(); }
+
+        /**
+         * Tile (ti, tj), holding rows [ti * tileSize, ...) and columns [tj * tileSize, ...).
+         */
+        T *tile(uint64_t ti, uint64_t tj) const
+        {
+            return reinterpret_cast<T*>(mapping_.data() + tileOffset(ti, tj));
+        }
+
+        T &at(uint64_t row, uint64_t col) const
+        {
+            return tile(row / tileSize(), col / tileSize())[(row % tileSize()) * stride() + col % tileSize()];
+        }
+
+        /**
+         * Pass madvise advice for one tile, e.g. MADV_WILLNEED to start reading it.
+         */
+        void advise(uint64_t ti, uint64_t tj, int advice) const
+        {
+            mapping_.advise(tileOffset(ti, tj), header().tileBytes, advice);
+        }
+
+        /**
+         * Start writing one tile back to the file.
+         */
+        void sync(uint64_t ti, uint64_t tj) const
+        {
+            mapping_.sync(tileOffset(ti, tj), header().tileBytes);
+        }
+
+        /**
+         * Write everything back and drop the file from the page cache, so
+         * the next access reads it from disk.
+         */
+        void evict() const { mapping_.evict(); }
+
+    private:
+        uint64_t tileOffset(uint64_t ti, uint64_t tj) const
+        {
+            return header().dataOffset + (ti * tileCols() + tj) * header().tileBytes;
+        }
+
+        Mapping mapping_;
+    };
+
+    template <typename T>
+    void write(const std::string &path, const Matrix<T> &matrix, uint64_t tileSize);
+    template <typename T>
+    Matrix<T> read(const std::string &path);
+}
+
+
+#endif
@@ -1,29 +1,41 @@
 #include "OMPParallelMultiplication.h"
+#include "PackedMultiplication.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+#include "Affinity.h"
+#include "Autotuner.h"
+#include "Transpose.h"
 
 #include <random>
 #include <chrono>
 #include <thread>
 #include <omp.h>
 #include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <memory>
+#include <algorithm>
 
 namespace OMPParallelMultiplication
 {
     /**
      * Print the given matrix to the console.
      * @param matrix: The matrix to be printed.
-     * @param size: The size of the matrix (assumed to be square).
      */
-    void printMatrix(uint64_t **matrix, const uint64_t size)
+    template <typename T>
+    void printMatrix(const Matrix<T> &matrix)
     {
         std::string mat;
-        for(uint64_t i = 0; i < size; i++) {
+        for(uint64_t i = 0; i < matrix.rows(); i++) {
             mat += "[";
-            for(uint64_t j = 0; j < size; j++) {
+            for(uint64_t j = 0; j < matrix.cols(); j++) {
                 if(j == 0) {
-                    mat += std::to_string(matrix[i][j]);
+                    mat += std::to_string(matrix(i, j));
                 } else {
                     mat += ", ";
-                    mat += std::to_string(matrix[i][j]);
+                    mat += std::to_string(matrix(i, j));
                 }
             }
             mat += "]\n";
@@ -32,72 +44,196 @@ namespace OMPParallelMultiplication
     }
 
     /**
-     * Initialize the given matrix with random values.
+     * Initialize the given matrix with random values. Rows are shared out
+     * with the same runtime schedule as multiplyMatrix, so under a static
+     * schedule each row is first touched by the thread that later uses it.
      * @param matrix: The matrix to be initialized.
-     * @param size: The size of the matrix (assumed to be square).
+     * @param seed: Seed of the counter-based generator.
      * @param low: Lower bound for random values.
      * @param high: Upper bound for random values.
+     * @param numThreads: Number of threads to use for parallelism.
      */
-    void randomMatrix(uint64_t **matrix, const uint64_t size,
-                      int low, int high, int numThreads)
+    template <typename T>
+    void randomMatrix(Matrix<T> &matrix, uint64_t seed, int low, int high, int numThreads)
     {
+        const uint64_t rows = matrix.rows();
 
-        std::random_device rd;
-        std::mt19937 rng(rd());
-        std::uniform_int_distribution<int> dist(low, high);
-
-    #pragma omp parallel for default(none) firstprivate (matrix, size, dist, rng) num_threads(numThreads)
-        for(uint64_t i = 0; i < size; i++) {
-            for(uint64_t j = 0; j < size; j++) {
-                matrix[i][j] = dist(rng);
-            }
+    #pragma omp parallel for default(none) shared(matrix) firstprivate (rows, seed, low, high) num_threads(numThreads) schedule(runtime)
+        for(uint64_t i = 0; i < rows; i++) {
+            CounterRandom::fillRows(matrix, seed, low, high, i, i + 1);
         }
     }
 
     /**
      * Multiply two matrices using OpenMP for parallelism and store the result in a third matrix.
+     * Products are summed in the accumulator type Acc.
      * @param m1: First matrix.
      * @param m2: Second matrix.
      * @param m3: Matrix to store the result.
-     * @param size: The size of the matrices (assumed to be square).
      * @param numThreads: Number of threads to use for parallelism.
      */
-    void multiplyMatrix(uint64_t **m1, uint64_t **m2, uint64_t **m3, const uint64_t size, int numThreads)
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3, int numThreads)
     {
-        #pragma omp parallel for default(none) firstprivate (m1, m2, m3, size) num_threads(numThreads)
-        for(uint64_t row = 0; row < size; row++) {
-            for(uint64_t col = 0; col < size; col++) {
-                m3[row][col] = 0;
-                for(uint64_t i = 0; i < size; i++) {
-                    m3[row][col] += m1[row][i] * m2[i][col];
+        const uint64_t rows = m3.rows();
+        const uint64_t cols = m3.cols();
+        const uint64_t inner = m1.cols();
+
+        #pragma omp parallel for default(none) shared(m1, m2, m3) firstprivate (rows, cols, inner) num_threads(numThreads) schedule(runtime)
+        for(uint64_t row = 0; row < rows; row++) {
+            const T *a = m1.row(row);
+            Acc *c = m3.row(row);
+            for(uint64_t col = 0; col < cols; col++) {
+                Acc sum = 0;
+                for(uint64_t i = 0; i < inner; i++) {
+                    sum += static_cast<Acc>(a[i]) * static_cast<Acc>(m2(i, col));
                 }
+                c[col] = sum;
             }
         }
     }
 
     /**
-     * Initialize a 2D array of given size.
-     * @param size: The size of the 2D array (assumed to be square).
-     * @return Pointer to the initialized 2D array.
+     * Leaf of the recursive multiply: C[i0:i1, j0:j1] += A[i0:i1, k0:k1] * B[k0:k1, j0:j1]
+     * with an i-k-j loop, so the innermost loop runs along rows of B and C and vectorizes.
      */
-    uint64_t **initArray(const uint64_t size)
+    template <typename T, typename Acc>
+    void multiplyLeaf(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                      uint64_t i0, uint64_t i1, uint64_t j0, uint64_t j1, uint64_t k0, uint64_t k1)
     {
-        uint64_t **arr;
-        arr = new uint64_t*[size];
-        for(uint64_t i = 0; i < size; i++) {
-            arr[i] = new uint64_t[size];
+        for(uint64_t i = i0; i < i1; i++) {
+            const T *a = m1.row(i);
+            Acc *c = m3.row(i);
+            for(uint64_t k = k0; k < k1; k++) {
+                const Acc aik = a[k];
+                const T *b = m2.row(k);
+                #pragma omp simd
+                for(uint64_t j = j0; j < j1; j++) {
+                    c[j] += aik * static_cast<Acc>(b[j]);
+                }
+            }
         }
-        return arr;
     }
 
     /**
-     * Run matrix multiplication for matrices of given size using OpenMP.
-     * @param size: The size of the matrices (assumed to be square).
+     * Cache-oblivious step: halve the largest of the three dimensions until
+     * all are at most leaf. Halves of rows or columns write disjoint parts
+     * of C and run as OMP tasks; halves of the inner dimension add into the
+     * same part of C, so they run one after the other.
+     */
+    template <typename T, typename Acc>
+    void multiplyRecursiveStep(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                               uint64_t i0, uint64_t i1, uint64_t j0, uint64_t j1, uint64_t k0, uint64_t k1,
+                               uint64_t leaf)
+    {
+        const uint64_t m = i1 - i0, n = j1 - j0, k = k1 - k0;
+        if(m <= leaf && n <= leaf && k <= leaf) {
+            multiplyLeaf(m1, m2, m3, i0, i1, j0, j1, k0, k1);
+            return;
+        }
+
+        // Tasks for sub-problems of a few leaves only cost more than they save.
+        const bool spawn = m * n * k > 8 * leaf * leaf * leaf;
+        if(m >= n && m >= k) {
+            const uint64_t mid = i0 + m / 2;
+            #pragma omp task default(none) shared(m1, m2, m3) firstprivate(i0, mid, j0, j1, k0, k1, leaf) if(spawn)
+            multiplyRecursiveStep(m1, m2, m3, i0, mid, j0, j1, k0, k1, leaf);
+            multiplyRecursiveStep(m1, m2, m3, mid, i1, j0, j1, k0, k1, leaf);
+            #pragma omp taskwait
+        } else if(n >= k) {
+            const uint64_t mid = j0 + n / 2;
+            #pragma omp task default(none) shared(m1, m2, m3) firstprivate(i0, i1, j0, mid, k0, k1, leaf) if(spawn)
+            multiplyRecursiveStep(m1, m2, m3, i0, i1, j0, mid, k0, k1, leaf);
+            multiplyRecursiveStep(m1, m2, m3, i0, i1, mid, j1, k0, k1, leaf);
+            #pragma omp taskwait
+        } else {
+            const uint64_t mid = k0 + k / 2;
+            multiplyRecursiveStep(m1, m2, m3, i0, i1, j0, j1, k0, mid, leaf);
+            multiplyRecursiveStep(m1, m2, m3, i0, i1, j0, j1, mid, k1, leaf);
+        }
+    }
+
+    /**
+     * Multiply two matrices by recursive halving over OpenMP tasks. Nothing
+     * is sized for a particular cache: every level of the recursion fits some
+     * level of the hierarchy, whatever its size.
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Matrix to store the result.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param leaf: Largest dimension handled by the leaf kernel.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrixRecursive(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3, int numThreads,
+                                 uint64_t leaf)
+    {
+        const uint64_t rows = m3.rows();
+        const uint64_t cols = m3.cols();
+        const uint64_t inner = m1.cols();
+        leaf = std::max<uint64_t>(1, leaf);
+
+        #pragma omp parallel default(none) shared(m1, m2, m3) firstprivate(rows, cols, inner, leaf) num_threads(numThreads)
+        {
+            #pragma omp for schedule(static)
+            for(uint64_t row = 0; row < rows; row++) {
+                std::fill(m3.row(row), m3.row(row) + cols, Acc{0});
+            }
+
+            #pragma omp single
+            multiplyRecursiveStep(m1, m2, m3, 0, rows, 0, cols, 0, inner, leaf);
+        }
+    }
+
+    /**
+     * Multiply m1 by a matrix given as its transpose using OpenMP. Pass a
+     * transpose made once to reuse it across several products.
+     * @param m1: First matrix.
+     * @param m2t: Transpose of the second matrix.
+     * @param m3: Matrix to store the result.
+     * @param numThreads: Number of threads to use for parallelism.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrixTransposed(const Matrix<T> &m1, const Matrix<T> &m2t, Matrix<Acc> &m3, int numThreads)
+    {
+        const uint64_t rows = m3.rows();
+        const uint64_t cols = m3.cols();
+        const uint64_t inner = m1.cols();
+
+        #pragma omp parallel for default(none) shared(m1, m2t, m3) firstprivate (rows, cols, inner) num_threads(numThreads) schedule(runtime)
+        for(uint64_t row = 0; row < rows; row++) {
+            const T *a = m1.row(row);
+            Acc *c = m3.row(row);
+            for(uint64_t col = 0; col < cols; col++) {
+                c[col] = Transpose::dot<T, Acc>(a, m2t.row(col), inner);
+            }
+        }
+    }
+
+    /**
+     * dst = srcᵀ, in blocks of rows of dst spread over the threads.
+     * @param src: Matrix to transpose.
+     * @param dst: Matrix receiving the transpose.
      * @param numThreads: Number of threads to use for parallelism.
-     * @param scheduleType: Type of scheduling to use.
-     * @return Duration taken for the multiplication operation.
      */
-    uint64_t run(const uint64_t size, int numThreads, int scheduleType, int chunkSize) {
+    template <typename T>
+    void transposeMatrix(const Matrix<T> &src, Matrix<T> &dst, int numThreads)
+    {
+        const uint64_t rows = dst.rows();
+        const uint64_t block = Transpose::blockSize;
+
+        #pragma omp parallel for default(none) shared(src, dst) firstprivate(rows, block) num_threads(numThreads)
+        for(uint64_t start = 0; start < rows; start += block) {
+            Transpose::transposeRows(src, dst, start, std::min(start + block, rows));
+        }
+    }
+
+    /**
+     * Set the schedule used by the schedule(runtime) loops.
+     * @param scheduleType: 1 static, 2 dynamic, 3 guided, anything else auto.
+     * @param chunkSize: Chunk size passed to the OMP schedule.
+     */
+    void setSchedule(int scheduleType, int chunkSize)
+    {
         switch(scheduleType)
         {
             case 1:
@@ -113,57 +249,113 @@ namespace OMPParallelMultiplication
                 omp_set_schedule(omp_sched_auto, 0);
                 break;
         }
+    }
 
-        uint64_t **v1, **v2, **v3;
+    /**
+     * Run matrix multiplication for matrices of given size using OpenMP.
+     * @tparam T: Storage type of the input matrices.
+     * @tparam Acc: Accumulator and result type.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param scheduleType: Type of scheduling to use, see setSchedule(), or scheduleTuned.
+     * @param chunkSize: Chunk size passed to the OMP schedule.
+     * @param kernel: Naive triple loop, the packed SIMD engine (uint64_t only),
+     *                transposed B (the transpose is included in the time), or
+     *                recursive, which takes chunkSize as its leaf size.
+     * @return Duration taken for the multiplication operation.
+     */
+    template <typename T, typename Acc>
+    uint64_t run(const uint64_t size, int numThreads, int scheduleType, int chunkSize, Kernel kernel) {
+        if(kernel == Kernel::Packed && !std::is_same_v<T, uint64_t>) {
+            throw std::invalid_argument("The packed kernel only supports uint64_t matrices.");
+        }
+
+        if(scheduleType == scheduleTuned) {
+            Autotuner::Setting setting;
+            if(Autotuner::lookup(size, numThreads, setting)) {
+                scheduleType = setting.scheduleType;
+                chunkSize = setting.chunkSize;
+                std::cout << "Using tuned schedule: " << Autotuner::scheduleName(scheduleType) << std::endl;
+            } else {
+                std::cout << "No tuned schedule in " << Autotuner::file() << ", using auto" << std::endl;
+                scheduleType = 0;
+            }
+        }
+        setSchedule(scheduleType, chunkSize);
+
+        // Bind the team for the whole run when an affinity policy is set
+        std::unique_ptr<Affinity::ScopedOmpPin> pin;
+        if(Affinity::enabled()) { pin = std::make_unique<Affinity::ScopedOmpPin>(numThreads); }
 
         // Initialize matrices
-        v1 = initArray(size);
-        v2 = initArray(size) ;
-        v3 = initArray(size) ;
+        Matrix<T> v1(size), v2(size);
+        Matrix<Acc> v3(size);
 
         // Fill matrices with random values
-        randomMatrix(v1, size, 1, 10, numThreads);
-        randomMatrix(v2, size, 1, 10, numThreads);
+        randomMatrix(v1, CounterRandom::streamSeed(0), 1, 10, numThreads);
+        randomMatrix(v2, CounterRandom::streamSeed(1), 1, 10, numThreads);
+
+        // First touch the result rows with the multiply's schedule, so each
+        // thread's rows are allocated on its own node.
+        if(Affinity::enabled()) {
+            #pragma omp parallel for default(none) shared(v3) firstprivate(size) num_threads(numThreads) schedule(runtime)
+            for(uint64_t row = 0; row < size; row++) {
+                std::fill(v3.row(row), v3.row(row) + size, 0);
+            }
+        }
 
         // Perform matrix multiplication using OpenMP and measure the time taken
+        PerfCounters::start();
         auto start = std::chrono::high_resolution_clock::now();
 
-        multiplyMatrix(v1, v2, v3, size, numThreads);
+        if(kernel == Kernel::Transposed) {
+            Matrix<T> v2t(size);
+            transposeMatrix(v2, v2t, numThreads);
+            multiplyMatrixTransposed(v1, v2t, v3, numThreads);
+        } else if(kernel == Kernel::Recursive) {
+            multiplyMatrixRecursive(v1, v2, v3, numThreads, chunkSize > 0 ? chunkSize : recursiveLeaf);
+        } else if(kernel == Kernel::Packed) {
+            // Only reachable for uint64_t, checked above.
+            if constexpr(std::is_same_v<T, uint64_t> && std::is_same_v<Acc, uint64_t>) {
+                PackedMultiplication::multiplyMatrix(v1, v2, v3, numThreads);
+            }
+        } else {
+            multiplyMatrix(v1, v2, v3, numThreads);
+        }
 
         auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
 
         auto duration = std::chrono::duration_cast
                         <std::chrono::microseconds>(end - start);
 
-        std::cout << "OMP Parallel Multiplication took: " << duration.count() << " microseconds, with chunksize: " << chunkSize << std::endl;
+        const char *label = kernel == Kernel::Packed ? "OMP Packed Multiplication took: "
+                          : kernel == Kernel::Transposed ? "OMP Transposed Multiplication took: "
+                          : kernel == Kernel::Recursive ? "OMP Recursive Multiplication took: "
+                          : "OMP Parallel Multiplication took: ";
+        std::cout << label << duration.count() << " microseconds, with chunksize: " << chunkSize << std::endl;
 
-        for(int i = 0; i < size; i++) {
-            for (int j = 0; j < size; j++) {
-                int result = 0;
-                for(int k = 0; k < size; k++) {
-                    result += v1[i][k] * v2[k][j];
-                }
-                if(v3[i][j] != result) {
-                    std::cout << "Error, value is not correct at: [" << i << ", " << j << "]" << std::endl;
-                    std::cout << "result: " << result << ", expected: " << v3[i][j] << std::endl;
+        // Check the result, timed separately from the multiplication
+        Verification::verify(v1, v2, v3);
 
-                    // Throw exception and stop program running if there's
-                    // any calculation is not correct.
-                    throw std::runtime_error("Result is incorrect.");
-                }
-            }
-        }
-
-        // Delete matrices and free memory
-        for(uint64_t i = 0; i < size; i++) {
-            delete[] v1[i];
-            delete[] v2[i];
-            delete[] v3[i];
+        if(Affinity::enabled()) {
+            Affinity::printPlacement("v1", v1.data(), v1.rows() * v1.stride() * sizeof(T));
+            Affinity::printPlacement("v3", v3.data(), v3.rows() * v3.stride() * sizeof(Acc));
         }
-        delete[] v1;
-        delete[] v2;
-        delete[] v3;
 
-    return duration.count();
+        return duration.count();
     }
-};
+
+    // Explicit instantiations for every supported element type. Every
+    // accumulator type is also a storage type, so printMatrix covers both.
+#define INSTANTIATE(name, T, Acc) \
+    template void printMatrix<T>(const Matrix<T> &); \
+    template void randomMatrix<T>(Matrix<T> &, uint64_t, int, int, int); \
+    template void multiplyMatrix<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, int); \
+    template void multiplyMatrixTransposed<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, int); \
+    template void multiplyMatrixRecursive<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, int, uint64_t); \
+    template void transposeMatrix<T>(const Matrix<T> &, Matrix<T> &, int); \
+    template uint64_t run<T, Acc>(uint64_t, int, int, int, Kernel);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
\ No newline at end of file
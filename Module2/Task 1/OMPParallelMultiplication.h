@@ -4,13 +4,46 @@
 #include <iostream>
 #include <random>
 
+#include "Matrix.h"
+
 namespace OMPParallelMultiplication
 {
-    void printMatrix(uint64_t **matrix,  uint64_t size);
-    void randomMatrix(uint64_t **matrix,  uint64_t size,
-                      int low, int high, int numThreads);
-    void multiplyMatrix(uint64_t **m1, uint64_t **m2, uint64_t **m3, uint64_t size, int numThreads);
-    uint64_t run(uint64_t size, int numThreads, int scheduleType, int chunkSize);
+    /**
+     * Kernel used by run(). Packed is the cache-blocked, SIMD micro-kernel
+     * engine from PackedMultiplication. Transposed transposes the second
+     * matrix first and takes unit-stride dot products. Recursive is the
+     * cache-oblivious divide and conquer over OMP tasks, with chunkSize as
+     * its leaf size.
+     */
+    enum class Kernel { Naive, Packed, Transposed, Recursive };
+
+    /**
+     * scheduleType for run() that applies the setting saved by the
+     * Autotuner for this size and thread count, or auto if there is none.
+     */
+    constexpr int scheduleTuned = 4;
+
+    // Leaf size of the recursive kernel when run() is given no chunk size.
+    // 64 x 64 tiles of the widest type are 32KB each, small enough for L1 or L2
+    // anywhere, and large enough to keep the recursion overhead low.
+    constexpr uint64_t recursiveLeaf = 64;
+
+    template <typename T>
+    void printMatrix(const Matrix<T> &matrix);
+    template <typename T>
+    void randomMatrix(Matrix<T> &matrix, uint64_t seed, int low, int high, int numThreads);
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3, int numThreads);
+    template <typename T, typename Acc>
+    void multiplyMatrixTransposed(const Matrix<T> &m1, const Matrix<T> &m2t, Matrix<Acc> &m3, int numThreads);
+    template <typename T, typename Acc>
+    void multiplyMatrixRecursive(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3, int numThreads,
+                                 uint64_t leaf);
+    template <typename T>
+    void transposeMatrix(const Matrix<T> &src, Matrix<T> &dst, int numThreads);
+    void setSchedule(int scheduleType, int chunkSize);
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(uint64_t size, int numThreads, int scheduleType, int chunkSize, Kernel kernel = Kernel::Naive);
 }
 
 
@@ -0,0 +1,185 @@
+#include "OutOfCoreMultiplication.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <omp.h>
+
+namespace OutOfCoreMultiplication
+{
+    /**
+     * c += a * b for one rows x depth by depth x cols tile product. The
+     * operand tiles have stride elements between rows, the result tile
+     * resultStride. Rows of c are split between threads.
+     */
+    template <typename T, typename Acc>
+    void multiplyTile(const T *a, const T *b, Acc *c, uint64_t rows, uint64_t cols, uint64_t depth,
+                      uint64_t stride, uint64_t resultStride, int numThreads)
+    {
+        #pragma omp parallel for default(none) shared(a, b, c) firstprivate(rows, cols, depth, stride, resultStride) num_threads(numThreads)
+        for(uint64_t i = 0; i < rows; i++) {
+            const T *aRow = a + i * stride;
+            Acc *cRow = c + i * resultStride;
+            for(uint64_t k = 0; k < depth; k++) {
+                const Acc aik = aRow[k];
+                const T *bRow = b + k * stride;
+                for(uint64_t j = 0; j < cols; j++) {
+                    cRow[j] += aik * static_cast<Acc>(bRow[j]);
+                }
+            }
+        }
+    }
+
+    /**
+     * m3 = m1 * m2 on mapped files. All three must use the same tile size.
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Receives the product, mapped writable.
+     * @param numThreads: Number of threads to use for parallelism.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrix(const MatrixFile::MappedMatrix<T> &m1, const MatrixFile::MappedMatrix<T> &m2,
+                        MatrixFile::MappedMatrix<Acc> &m3, int numThreads)
+    {
+        if(m1.cols() != m2.rows() || m3.rows() != m1.rows() || m3.cols() != m2.cols()) {
+            throw std::invalid_argument("Matrix file shapes do not match.");
+        }
+        if(m1.tileSize() != m2.tileSize() || m1.tileSize() != m3.tileSize()) {
+            throw std::invalid_argument("Matrix files must share a tile size.");
+        }
+
+        const uint64_t tile = m1.tileSize(), stride = m1.stride(), resultStride = m3.stride();
+        const uint64_t tileRows = m3.tileRows(), tileCols = m3.tileCols(), tileDepth = m1.tileCols();
+        const uint64_t steps = tileRows * tileCols * tileDepth;
+
+        // Start reading the operands of one tile product, numbered in the
+        // order the loops below visit them.
+        auto prefetch = [&](uint64_t step) {
+            if(step >= steps) { return; }
+            const uint64_t tk = step % tileDepth, tj = (step / tileDepth) % tileCols, ti = step / (tileDepth * tileCols);
+            m1.advise(ti, tk, MADV_WILLNEED);
+            m2.advise(tk, tj, MADV_WILLNEED);
+        };
+        for(uint64_t step = 0; step < lookahead; step++) { prefetch(step); }
+
+        uint64_t step = 0;
+        for(uint64_t ti = 0; ti < tileRows; ti++) {
+            const uint64_t rows = std::min(tile, m3.rows() - ti * tile);
+            for(uint64_t tj = 0; tj < tileCols; tj++) {
+                const uint64_t cols = std::min(tile, m3.cols() - tj * tile);
+                Acc *c = m3.tile(ti, tj);
+                for(uint64_t i = 0; i < rows; i++) { std::fill(c + i * resultStride, c + i * resultStride + cols, Acc{0}); }
+
+                for(uint64_t tk = 0; tk < tileDepth; tk++, step++) {
+                    prefetch(step + lookahead);
+                    const uint64_t depth = std::min(tile, m1.cols() - tk * tile);
+                    multiplyTile(m1.tile(ti, tk), m2.tile(tk, tj), c, rows, cols, depth, stride, resultStride, numThreads);
+                    m2.advise(tk, tj, MADV_DONTNEED);
+                }
+
+                // The tile stays in the page cache until it is written, this
+                // only drops it from our mapping.
+                m3.sync(ti, tj);
+                m3.advise(ti, tj, MADV_DONTNEED);
+            }
+            for(uint64_t tk = 0; tk < tileDepth; tk++) { m1.advise(ti, tk, MADV_DONTNEED); }
+        }
+    }
+
+    /**
+     * Multiply two matrix files into a new one, e.g. from --multiply.
+     * @param path1: File of the first matrix.
+     * @param path2: File of the second matrix.
+     * @param path3: File to create for the product, with the tile size of path1.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @return Duration taken for the multiplication operation.
+     */
+    template <typename T, typename Acc>
+    uint64_t multiplyFiles(const std::string &path1, const std::string &path2, const std::string &path3,
+                           int numThreads)
+    {
+        MatrixFile::MappedMatrix<T> m1(path1), m2(path2);
+        auto m3 = MatrixFile::MappedMatrix<Acc>::create(path3, m1.rows(), m2.cols(), m1.tileSize());
+
+        PerfCounters::start();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        multiplyMatrix(m1, m2, m3, numThreads);
+        m3.evict();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
+
+        auto duration = std::chrono::duration_cast
+                        <std::chrono::microseconds>(end - start);
+        std::cout << "Out-of-core Multiplication took: " << duration.count() << " microseconds, wrote "
+                  << path3 << std::endl;
+        return duration.count();
+    }
+
+    /**
+     * Write a random size x size matrix file, tile by tile, so it never has
+     * to fit in memory. Then drop it from the page cache.
+     */
+    template <typename T>
+    void randomFile(const std::string &path, uint64_t size, uint64_t tileSize, uint64_t seed, int numThreads)
+    {
+        auto file = MatrixFile::MappedMatrix<T>::create(path, size, size, tileSize);
+        const uint64_t tiles = file.tileRows() * file.tileCols();
+        #pragma omp parallel for default(none) shared(file) firstprivate(tiles, size, seed) num_threads(numThreads) schedule(dynamic)
+        for(uint64_t t = 0; t < tiles; t++) {
+            const uint64_t row0 = (t / file.tileCols()) * file.tileSize(), col0 = (t % file.tileCols()) * file.tileSize();
+            T *tile = file.tile(t / file.tileCols(), t % file.tileCols());
+            for(uint64_t i = row0; i < std::min(row0 + file.tileSize(), size); i++) {
+                for(uint64_t j = col0; j < std::min(col0 + file.tileSize(), size); j++) {
+                    tile[(i - row0) * file.stride() + (j - col0)] = static_cast<T>(CounterRandom::at(seed, i, j, 1, 10));
+                }
+            }
+        }
+        file.evict();
+    }
+
+    /**
+     * Run the out-of-core multiplication on random matrix files.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param tileSize: Edge length of the file tiles.
+     * @param directory: Where the three files are written; they are removed afterwards.
+     * @return Duration taken for the multiplication operation.
+     */
+    template <typename T, typename Acc>
+    uint64_t run(const uint64_t size, int numThreads, uint64_t tileSize, const std::string &directory)
+    {
+        const std::string path1 = directory + "/ooc_a.mat", path2 = directory + "/ooc_b.mat";
+        const std::string path3 = directory + "/ooc_c.mat";
+
+        // Write the inputs to disk, not cached, so the multiply has to read them
+        randomFile<T>(path1, size, tileSize, CounterRandom::streamSeed(0), numThreads);
+        randomFile<T>(path2, size, tileSize, CounterRandom::streamSeed(1), numThreads);
+
+        const uint64_t duration = multiplyFiles<T, Acc>(path1, path2, path3, numThreads);
+
+        // Check the result, timed separately from the multiplication. This
+        // reads all three files back into memory, so it is for benchmark sizes.
+        Verification::verify(MatrixFile::read<T>(path1), MatrixFile::read<T>(path2), MatrixFile::read<Acc>(path3));
+
+        std::remove(path1.c_str());
+        std::remove(path2.c_str());
+        std::remove(path3.c_str());
+        return duration;
+    }
+
+#define INSTANTIATE(name, T, Acc) \
+    template void multiplyMatrix<T, Acc>(const MatrixFile::MappedMatrix<T> &, const MatrixFile::MappedMatrix<T> &, \
+                                         MatrixFile::MappedMatrix<Acc> &, int); \
+    template uint64_t multiplyFiles<T, Acc>(const std::string &, const std::string &, const std::string &, int); \
+    template uint64_t run<T, Acc>(uint64_t, int, uint64_t, const std::string &);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
@@ -0,0 +1,36 @@
+#ifndef OUT_OF_CORE_MULTIPLICATION_H
+#define OUT_OF_CORE_MULTIPLICATION_H
+
+#include <iostream>
+#include <cstdint>
+#include <string>
+
+#include "MatrixFile.h"
+
+/**
+ * Multiplication of matrix files larger than memory.
+ *
+ * C is produced one tile at a time, as the sum over k of A(i, k) * B(k, j),
+ * with every tile used in place in its mapping. Before each tile product
+ * the tiles a few steps ahead are advised MADV_WILLNEED, so the kernel
+ * reads them while this one is computed. Finished C tiles are written back
+ * and unmapped, and so are A tiles once their row of C is done, which keeps
+ * the resident set to a handful of tiles whatever the file sizes.
+ */
+namespace OutOfCoreMultiplication
+{
+    // Tile products the read-ahead runs ahead of the multiply.
+    constexpr uint64_t lookahead = 2;
+
+    template <typename T, typename Acc>
+    void multiplyMatrix(const MatrixFile::MappedMatrix<T> &m1, const MatrixFile::MappedMatrix<T> &m2,
+                        MatrixFile::MappedMatrix<Acc> &m3, int numThreads);
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t multiplyFiles(const std::string &path1, const std::string &path2, const std::string &path3,
+                           int numThreads);
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(uint64_t size, int numThreads, uint64_t tileSize, const std::string &directory);
+}
+
+
+#endif
@@ -0,0 +1,341 @@
+#include "PackedMultiplication.h"
+#include "CacheInfo.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#include <omp.h>
+
+/*
+ * BLIS style GEMM. The loops around the micro-kernel are:
+ *
+ *   jc: NC columns of B/C          (sized for L3)
+ *     pc: KC depth                 (sized for L1), pack B[pc, jc] into NR wide panels
+ *       ic: MC rows of A/C         (sized for L2), pack A[ic, pc] into MR tall panels
+ *         jr, ir: MR x NR tile of C, computed in registers by the micro-kernel
+ *
+ * The B packing and the ic loop are shared across the OMP team using the
+ * runtime schedule, so omp_set_schedule() in OMPParallelMultiplication::run
+ * applies here as well.
+ */
+namespace PackedMultiplication
+{
+    // Largest tile any micro-kernel uses, sizes the edge buffer.
+    constexpr uint64_t maxMR = 6;
+    constexpr uint64_t maxNR = 16;
+
+    /**
+     * Computes one MR x NR tile of C from packed panels of A and B.
+     * @param kc: Depth of the panels.
+     * @param a: Packed A panel, kc groups of MR values.
+     * @param b: Packed B panel, kc groups of NR values.
+     * @param c: Top left of the C tile.
+     * @param ldc: Row stride of C.
+     * @param accumulate: Add to C rather than overwrite it.
+     */
+    using MicroKernel = void (*)(uint64_t kc, const uint64_t *a, const uint64_t *b,
+                                 uint64_t *c, uint64_t ldc, bool accumulate);
+
+    struct KernelInfo
+    {
+        uint64_t mr;
+        uint64_t nr;
+        MicroKernel kernel;
+    };
+
+    /**
+     * Portable micro-kernel, used when no vector extension is available.
+     */
+    template <uint64_t MR, uint64_t NR>
+    void kernelScalar(uint64_t kc, const uint64_t *a, const uint64_t *b,
+                      uint64_t *c, uint64_t ldc, bool accumulate)
+    {
+        uint64_t acc[MR][NR] = {};
+        for(uint64_t p = 0; p < kc; p++) {
+            for(uint64_t r = 0; r < MR; r++) {
+                const uint64_t ar = a[r];
+                for(uint64_t j = 0; j < NR; j++) {
+                    acc[r][j] += ar * b[j];
+                }
+            }
+            a += MR;
+            b += NR;
+        }
+        for(uint64_t r = 0; r < MR; r++) {
+            for(uint64_t j = 0; j < NR; j++) {
+                c[r * ldc + j] = accumulate ? c[r * ldc + j] + acc[r][j] : acc[r][j];
+            }
+        }
+    }
+
+    /**
+     * Low 64 bits of a 64 x 64 bit multiply. AVX2 has no vpmullq, so it is
+     * built from 32 bit multiplies: lo*lo + ((lo*hi + hi*lo) << 32).
+     */
+    __attribute__((target("avx2")))
+    inline __m256i mullo64(__m256i a, __m256i b)
+    {
+        __m256i cross = _mm256_mullo_epi32(a, _mm256_shuffle_epi32(b, 0xB1));
+        __m256i crossSum = _mm256_add_epi32(cross, _mm256_srli_epi64(cross, 32));
+        return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(crossSum, 32));
+    }
+
+    /**
+     * 4 x 8 AVX2 micro-kernel: two ymm registers per row of C, eight accumulators.
+     */
+    __attribute__((target("avx2")))
+    void kernelAvx2(uint64_t kc, const uint64_t *a, const uint64_t *b,
+                    uint64_t *c, uint64_t ldc, bool accumulate)
+    {
+        constexpr int MR = 4;
+        __m256i acc[MR][2];
+        #pragma GCC unroll 4
+        for(int r = 0; r < MR; r++) {
+            acc[r][0] = _mm256_setzero_si256();
+            acc[r][1] = _mm256_setzero_si256();
+        }
+
+        for(uint64_t p = 0; p < kc; p++) {
+            const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+            const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 4));
+            #pragma GCC unroll 4
+            for(int r = 0; r < MR; r++) {
+                const __m256i ar = _mm256_set1_epi64x(static_cast<long long>(a[r]));
+                acc[r][0] = _mm256_add_epi64(acc[r][0], mullo64(ar, b0));
+                acc[r][1] = _mm256_add_epi64(acc[r][1], mullo64(ar, b1));
+            }
+            a += MR;
+            b += 8;
+        }
+
+        #pragma GCC unroll 4
+        for(int r = 0; r < MR; r++) {
+            auto *c0 = reinterpret_cast<__m256i*>(c + r * ldc);
+            auto *c1 = reinterpret_cast<__m256i*>(c + r * ldc + 4);
+            if(accumulate) {
+                acc[r][0] = _mm256_add_epi64(acc[r][0], _mm256_loadu_si256(c0));
+                acc[r][1] = _mm256_add_epi64(acc[r][1], _mm256_loadu_si256(c1));
+            }
+            _mm256_storeu_si256(c0, acc[r][0]);
+            _mm256_storeu_si256(c1, acc[r][1]);
+        }
+    }
+
+    /**
+     * 6 x 16 AVX-512 micro-kernel: two zmm registers per row of C, twelve accumulators.
+     */
+    __attribute__((target("avx512f,avx512dq")))
+    void kernelAvx512(uint64_t kc, const uint64_t *a, const uint64_t *b,
+                      uint64_t *c, uint64_t ldc, bool accumulate)
+    {
+        constexpr int MR = 6;
+        __m512i acc[MR][2];
+        #pragma GCC unroll 6
+        for(int r = 0; r < MR; r++) {
+            acc[r][0] = _mm512_setzero_si512();
+            acc[r][1] = _mm512_setzero_si512();
+        }
+
+        for(uint64_t p = 0; p < kc; p++) {
+            const __m512i b0 = _mm512_loadu_si512(b);
+            const __m512i b1 = _mm512_loadu_si512(b + 8);
+            #pragma GCC unroll 6
+            for(int r = 0; r < MR; r++) {
+                const __m512i ar = _mm512_set1_epi64(static_cast<long long>(a[r]));
+                acc[r][0] = _mm512_add_epi64(acc[r][0], _mm512_mullo_epi64(ar, b0));
+                acc[r][1] = _mm512_add_epi64(acc[r][1], _mm512_mullo_epi64(ar, b1));
+            }
+            a += MR;
+            b += 16;
+        }
+
+        #pragma GCC unroll 6
+        for(int r = 0; r < MR; r++) {
+            uint64_t *row = c + r * ldc;
+            if(accumulate) {
+                acc[r][0] = _mm512_add_epi64(acc[r][0], _mm512_loadu_si512(row));
+                acc[r][1] = _mm512_add_epi64(acc[r][1], _mm512_loadu_si512(row + 8));
+            }
+            _mm512_storeu_si512(row, acc[r][0]);
+            _mm512_storeu_si512(row + 8, acc[r][1]);
+        }
+    }
+
+    /**
+     * Pick the widest instruction set the CPU supports.
+     */
+    Isa detectIsa()
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+            return Isa::AVX512;
+        }
+        if(__builtin_cpu_supports("avx2")) {
+            return Isa::AVX2;
+        }
+        return Isa::Scalar;
+    }
+
+    const char *isaName(Isa isa)
+    {
+        switch(isa)
+        {
+            case Isa::AVX512: return "AVX512";
+            case Isa::AVX2: return "AVX2";
+            default: return "Scalar";
+        }
+    }
+
+    KernelInfo kernelFor(Isa isa)
+    {
+        switch(isa)
+        {
+            case Isa::AVX512: return {6, 16, kernelAvx512};
+            case Isa::AVX2: return {4, 8, kernelAvx2};
+            default: return {4, 4, kernelScalar<4, 4>};
+        }
+    }
+
+    /**
+     * Copy a kc x NR panel of B into contiguous memory, zero padding past the last column.
+     */
+    void packB(const Matrix<uint64_t> &m2, uint64_t pc, uint64_t kc, uint64_t col, uint64_t nr,
+               uint64_t *dest)
+    {
+        const uint64_t valid = std::min(nr, m2.cols() - col);
+        for(uint64_t p = 0; p < kc; p++) {
+            const uint64_t *src = m2.row(pc + p) + col;
+            uint64_t j = 0;
+            for(; j < valid; j++) { dest[j] = src[j]; }
+            for(; j < nr; j++) { dest[j] = 0; }
+            dest += nr;
+        }
+    }
+
+    /**
+     * Copy an MR x kc panel of A into contiguous, column-interleaved memory,
+     * zero padding past the last row.
+     */
+    void packA(const Matrix<uint64_t> &m1, uint64_t row, uint64_t pc, uint64_t kc, uint64_t mr,
+               uint64_t *dest)
+    {
+        const uint64_t valid = std::min(mr, m1.rows() - row);
+        for(uint64_t r = 0; r < valid; r++) {
+            const uint64_t *src = m1.row(row + r) + pc;
+            for(uint64_t p = 0; p < kc; p++) {
+                dest[p * mr + r] = src[p];
+            }
+        }
+        for(uint64_t r = valid; r < mr; r++) {
+            for(uint64_t p = 0; p < kc; p++) {
+                dest[p * mr + r] = 0;
+            }
+        }
+    }
+
+    /**
+     * Multiply two matrices with packed panels and a register-blocked micro-kernel.
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Matrix to store the result.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param isa: Instruction set of the micro-kernel.
+     */
+    void multiplyMatrix(const Matrix<uint64_t> &m1, const Matrix<uint64_t> &m2, Matrix<uint64_t> &m3,
+                        int numThreads, Isa isa)
+    {
+        const uint64_t m = m3.rows();
+        const uint64_t n = m3.cols();
+        const uint64_t k = m1.cols();
+        const KernelInfo info = kernelFor(isa);
+        const uint64_t mr = info.mr;
+        const uint64_t nr = info.nr;
+
+        if(k == 0) {
+            for(uint64_t i = 0; i < m; i++) { std::fill(m3.row(i), m3.row(i) + n, 0); }
+            return;
+        }
+
+        // Block sizes: a KC x NR sliver of B stays in L1, an MC x KC block
+        // of A in L2 and the KC x NC panel of B in L3.
+        const CacheInfo::CacheSizes &cache = CacheInfo::get();
+        uint64_t kc = std::max<uint64_t>(cache.l1d / 2 / (nr * sizeof(uint64_t)), 1);
+        kc = std::min(kc, k);
+        uint64_t mc = std::max<uint64_t>(cache.l2 / 2 / (kc * sizeof(uint64_t)) / mr, 1) * mr;
+        // Make sure every thread gets at least one block of rows.
+        const uint64_t rowsPerThread = (m + numThreads - 1) / numThreads;
+        mc = std::min(mc, std::max<uint64_t>((rowsPerThread + mr - 1) / mr, 1) * mr);
+        uint64_t nc = std::max<uint64_t>(cache.l3 / 2 / (kc * sizeof(uint64_t)) / nr, 1) * nr;
+        nc = std::min(nc, (n + nr - 1) / nr * nr);
+
+        Matrix<uint64_t> packedB(1, kc * nc);
+        Matrix<uint64_t> packedA(numThreads, mc * kc);
+
+        #pragma omp parallel default(none) shared(m1, m2, m3, packedA, packedB) \
+            firstprivate(m, n, k, mr, nr, kc, mc, nc, info) num_threads(numThreads)
+        {
+            uint64_t *aBuf = packedA.row(omp_get_thread_num());
+            uint64_t *bBuf = packedB.data();
+            uint64_t edge[maxMR * maxNR];
+
+            for(uint64_t jc = 0; jc < n; jc += nc) {
+                const uint64_t ncCur = std::min(nc, n - jc);
+                const uint64_t bPanels = (ncCur + nr - 1) / nr;
+
+                for(uint64_t pc = 0; pc < k; pc += kc) {
+                    const uint64_t kcCur = std::min(kc, k - pc);
+                    const bool accumulate = pc != 0;
+
+                    #pragma omp for schedule(runtime)
+                    for(uint64_t panel = 0; panel < bPanels; panel++) {
+                        packB(m2, pc, kcCur, jc + panel * nr, nr, bBuf + panel * kcCur * nr);
+                    }
+
+                    const uint64_t mBlocks = (m + mc - 1) / mc;
+                    #pragma omp for schedule(runtime)
+                    for(uint64_t block = 0; block < mBlocks; block++) {
+                        const uint64_t ic = block * mc;
+                        const uint64_t mcCur = std::min(mc, m - ic);
+                        const uint64_t aPanels = (mcCur + mr - 1) / mr;
+                        for(uint64_t panel = 0; panel < aPanels; panel++) {
+                            packA(m1, ic + panel * mr, pc, kcCur, mr, aBuf + panel * kcCur * mr);
+                        }
+
+                        for(uint64_t jr = 0; jr < ncCur; jr += nr) {
+                            const uint64_t nrCur = std::min(nr, ncCur - jr);
+                            const uint64_t *bPanel = bBuf + (jr / nr) * kcCur * nr;
+                            for(uint64_t ir = 0; ir < mcCur; ir += mr) {
+                                const uint64_t mrCur = std::min(mr, mcCur - ir);
+                                const uint64_t *aPanel = aBuf + (ir / mr) * kcCur * mr;
+                                uint64_t *c = m3.row(ic + ir) + jc + jr;
+
+                                if(mrCur == mr && nrCur == nr) {
+                                    info.kernel(kcCur, aPanel, bPanel, c, m3.stride(), accumulate);
+                                    continue;
+                                }
+                                // Partial tile on the bottom/right edge, compute
+                                // into a scratch tile and copy out the valid part.
+                                info.kernel(kcCur, aPanel, bPanel, edge, nr, false);
+                                for(uint64_t r = 0; r < mrCur; r++) {
+                                    uint64_t *cRow = c + r * m3.stride();
+                                    for(uint64_t j = 0; j < nrCur; j++) {
+                                        cRow[j] = accumulate ? cRow[j] + edge[r * nr + j] : edge[r * nr + j];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Multiply using the widest micro-kernel the CPU supports.
+     */
+    void multiplyMatrix(const Matrix<uint64_t> &m1, const Matrix<uint64_t> &m2, Matrix<uint64_t> &m3,
+                        int numThreads)
+    {
+        static const Isa isa = detectIsa();
+        multiplyMatrix(m1, m2, m3, numThreads, isa);
+    }
+};
@@ -0,0 +1,24 @@
+#ifndef PACKED_MULTIPLICATION_H
+#define PACKED_MULTIPLICATION_H
+
+#include <cstdint>
+
+#include "Matrix.h"
+
+namespace PackedMultiplication
+{
+    /**
+     * Instruction set used by the register-blocked micro-kernel.
+     */
+    enum class Isa { Scalar, AVX2, AVX512 };
+
+    Isa detectIsa();
+    const char *isaName(Isa isa);
+    void multiplyMatrix(const Matrix<uint64_t> &m1, const Matrix<uint64_t> &m2, Matrix<uint64_t> &m3,
+                        int numThreads, Isa isa);
+    void multiplyMatrix(const Matrix<uint64_t> &m1, const Matrix<uint64_t> &m2, Matrix<uint64_t> &m3,
+                        int numThreads);
+}
+
+
+#endif
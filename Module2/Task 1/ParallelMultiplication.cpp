@@ -1,28 +1,51 @@
 #include "ParallelMultiplication.h"
+#include "CacheInfo.h"
+#include "ThreadPool.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+#include "Transpose.h"
+#include "Affinity.h"
 
 #include <random>
 #include <chrono>
-#include <thread>
-#include <vector>
-#include <mutex>
+#include <algorithm>
+#include <memory>
 
 namespace ParallelMultiplication
 {
+    /**
+     * Return the shared worker pool, only recreating it when the requested
+     * thread count or pinning changes, so repeated runs reuse the same threads.
+     * @param numThreads: Number of threads the pool should have.
+     * @param pin: Whether workers are pinned to CPUs.
+     */
+    ThreadPool &getPool(int numThreads, bool pin)
+    {
+        static std::unique_ptr<ThreadPool> pool;
+        if(!pool || pool->size() != numThreads || pool->pinned() != pin) {
+            pool.reset();
+            pool = std::make_unique<ThreadPool>(numThreads, pin);
+        }
+        return *pool;
+    }
+
     /**
      * Print the given matrix to the console.
      * @param matrix: The matrix to be printed.
-     * @param size: The size of the matrix (assumed to be square).
      */
-    void printMatrix(uint64_t **matrix, const uint64_t size) {
+    template <typename T>
+    void printMatrix(const Matrix<T> &matrix) {
         std::string mat;
-        for(uint64_t i = 0; i < size; i++) {
+        for(uint64_t i = 0; i < matrix.rows(); i++) {
             mat += "[";
-            for(uint64_t j = 0; j < size; j++) {
+            for(uint64_t j = 0; j < matrix.cols(); j++) {
                 if(j == 0) {
-                    mat += std::to_string(matrix[i][j]);
+                    mat += std::to_string(matrix(i, j));
                 } else {
                     mat += ", ";
-                    mat += std::to_string(matrix[i][j]);
+                    mat += std::to_string(matrix(i, j));
                 }
             }
             mat += "]\n";
@@ -33,18 +56,15 @@ namespace ParallelMultiplication
     /**
      * Initialize the given matrix with random values.
      * @param matrix: The matrix to be initialized.
-     * @param size: The size of the matrix (assumed to be square).
+     * @param seed: Seed of the counter-based generator.
      * @param low: Lower bound for random values.
      * @param high: Upper bound for random values.
+     * @param pool: Threads to fill the rows with.
      */
-    void randomMatrix(uint64_t **matrix, const uint64_t size, int low, int high, int numThreads)
+    template <typename T>
+    void randomMatrix(Matrix<T> &matrix, uint64_t seed, int low, int high, ThreadPool &pool)
     {
-        std::random_device rd;
-        std::mt19937 rng(rd());
-        std::uniform_int_distribution<int> dist(low, high);
-
-        // Calculate the number of rows each thread should handle
-        uint64_t rowsPerThread = size / numThreads;
+        const uint64_t size = matrix.rows();
 
         /**
          * A lambda function to populate a specified range of rows (from startRow to endRow)
@@ -54,138 +74,224 @@ namespace ParallelMultiplication
          * @param endRow: The ending row index (exclusive) for element population.
          */
         auto populateRows = [&](uint64_t startRow, uint64_t endRow) {
-            for(uint64_t i = startRow; i < endRow; i++) {
-                for(uint64_t j = 0; j < size; j++) {
-                    matrix[i][j] = dist(rng);
-                }
-            }
+            CounterRandom::fillRows(matrix, seed, low, high, startRow, endRow);
         };
 
-        std::vector<std::thread> randomThreads;
-        for(int th = 0; th < numThreads; th++) {
-            uint64_t startRow = th * rowsPerThread;
-            // If we're at the last thread let it handle the rest
-            // of the array, no matter the size.
-            uint64_t endRow = (th == numThreads - 1) ? size : startRow + rowsPerThread;
-            randomThreads.emplace_back(populateRows, startRow, endRow);
-        }
-
-        for(auto& t : randomThreads) { t.join(); }
+        pool.parallelFor(0, size, populateRows);
     }
 
     /**
      * Multiply two matrices using parallel threads and store the result in a third matrix.
+     * Products are summed in the accumulator type Acc.
      * @param m1: First matrix.
      * @param m2: Second matrix.
      * @param m3: Matrix to store the result.
-     * @param size: The size of the matrices (assumed to be square).
      * @param startRow: Starting row for this segment of multiplication.
      * @param endRow: Ending row for this segment of multiplication.
      */
-    void multiplyMatrix(uint64_t **m1, uint64_t **m2, uint64_t **m3,
-                        const uint64_t size, uint64_t startRow, uint64_t endRow)
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                        uint64_t startRow, uint64_t endRow)
     {
+        const uint64_t inner = m1.cols();
         for(uint64_t row = startRow; row < endRow; row++) {
-            for(uint64_t col = 0; col < size; col++) {
-                m3[row][col] = 0;
-                for(uint64_t i = 0; i < size; i++) {
-                    m3[row][col] += m1[row][i] * m2[i][col];
+            const T *a = m1.row(row);
+            Acc *c = m3.row(row);
+            for(uint64_t col = 0; col < m3.cols(); col++) {
+                Acc sum = 0;
+                for(uint64_t i = 0; i < inner; i++) {
+                    sum += static_cast<Acc>(a[i]) * static_cast<Acc>(m2(i, col));
                 }
+                c[col] = sum;
             }
         }
     }
 
     /**
-     * Initialize a 2D array of given size.
-     * @param size: The size of the 2D array (assumed to be square).
-     * @return Pointer to the initialized 2D array.
+     * Multiply rows startRow..endRow of m1 by a matrix given as its
+     * transpose, each element a dot product of two unit-stride rows.
+     * @param m1: First matrix.
+     * @param m2t: Transpose of the second matrix.
+     * @param m3: Matrix to store the result.
+     * @param startRow: Starting row for this segment of multiplication.
+     * @param endRow: Ending row for this segment of multiplication.
      */
-    uint64_t **initArray(const uint64_t size)
+    template <typename T, typename Acc>
+    void multiplyMatrixTransposed(const Matrix<T> &m1, const Matrix<T> &m2t, Matrix<Acc> &m3,
+                                  uint64_t startRow, uint64_t endRow)
     {
-        uint64_t **arr;
-        arr = new uint64_t*[size];
-        for(uint64_t i = 0; i < size; i++) {
-            arr[i] = new uint64_t[size];
+        const uint64_t inner = m1.cols();
+        for(uint64_t row = startRow; row < endRow; row++) {
+            const T *a = m1.row(row);
+            Acc *c = m3.row(row);
+            for(uint64_t col = 0; col < m3.cols(); col++) {
+                c[col] = Transpose::dot<T, Acc>(a, m2t.row(col), inner);
+            }
+        }
+    }
+
+    /**
+     * Cache-blocked version of multiplyMatrix. The rows startRow..endRow are
+     * walked in blockSize x blockSize tiles using an i-k-j loop order, so the
+     * inner loop reads rows of m2 and m3 with unit stride.
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Matrix to store the result.
+     * @param startRow: Starting row for this segment of multiplication.
+     * @param endRow: Ending row for this segment of multiplication.
+     * @param blockSize: Edge length of a tile, in elements.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrixTiled(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                             uint64_t startRow, uint64_t endRow, uint64_t blockSize)
+    {
+        const uint64_t inner = m1.cols();
+        const uint64_t cols = m3.cols();
+
+        for(uint64_t row = startRow; row < endRow; row++) {
+            std::fill(m3.row(row), m3.row(row) + cols, 0);
+        }
+
+        for(uint64_t ii = startRow; ii < endRow; ii += blockSize) {
+            const uint64_t iEnd = std::min(ii + blockSize, endRow);
+            for(uint64_t kk = 0; kk < inner; kk += blockSize) {
+                const uint64_t kEnd = std::min(kk + blockSize, inner);
+                for(uint64_t jj = 0; jj < cols; jj += blockSize) {
+                    const uint64_t jEnd = std::min(jj + blockSize, cols);
+                    for(uint64_t i = ii; i < iEnd; i++) {
+                        const T *a = m1.row(i);
+                        Acc *c = m3.row(i);
+                        for(uint64_t k = kk; k < kEnd; k++) {
+                            const Acc aik = a[k];
+                            const T *b = m2.row(k);
+                            for(uint64_t j = jj; j < jEnd; j++) {
+                                c[j] += aik * static_cast<Acc>(b[j]);
+                            }
+                        }
+                    }
+                }
+            }
         }
-        return arr;
     }
 
     /**
      * Run matrix multiplication for matrices of given size using parallel threads.
+     * @tparam T: Storage type of the input matrices.
+     * @tparam Acc: Accumulator and result type.
      * @param size: The size of the matrices (assumed to be square).
      * @param numThreads: Number of threads to use for parallelism.
+     * @param mode: Kernel each thread runs on its rows, plain or cache-blocked.
+     * @param pinThreads: Pin the pool's worker threads to CPUs. Always on when
+     *                    an affinity policy is set.
+     * @param stats: If given, receives the steal count and idle time of the WorkStealing mode.
      * @return Duration taken for the multiplication operation.
      */
-    uint64_t run(const uint64_t size, int numThreads) {
-
-        uint64_t **v1, **v2, **v3;
+    template <typename T, typename Acc>
+    uint64_t run(const uint64_t size, int numThreads, TileMode mode, bool pinThreads,
+                 WorkStealing::Stats *stats) {
 
-        // Calculate number of rows per thread
-        uint64_t rowsPerThread = size / numThreads;
+        // Create (or reuse) the pool before timing anything
+        ThreadPool &pool = getPool(numThreads, pinThreads || Affinity::enabled());
 
         // Initialize matrices
-        v1 = initArray(size);
-        v2 = initArray(size) ;
-        v3 = initArray(size) ;
+        Matrix<T> v1(size), v2(size);
+        Matrix<Acc> v3(size);
 
         // Fill matrices with random values
-        randomMatrix(v1, size, 1, 10, numThreads/2);
-        randomMatrix(v2, size, 1, 10, numThreads/2);
+        randomMatrix(v1, CounterRandom::streamSeed(0), 1, 10, pool);
+        randomMatrix(v2, CounterRandom::streamSeed(1), 1, 10, pool);
 
+        // With an affinity policy, each thread first touches the band of the
+        // result it writes, so those pages are allocated on its own node.
+        if(Affinity::enabled()) {
+            pool.parallelFor(0, size, [&](uint64_t startRow, uint64_t endRow) {
+                for(uint64_t row = startRow; row < endRow; row++) {
+                    std::fill(v3.row(row), v3.row(row) + size, 0);
+                }
+            });
+        }
+
+        // Pick the tile edge for the requested cache level
+        uint64_t blockSize = 0;
+        switch(mode)
+        {
+            case TileMode::L1: blockSize = CacheInfo::blockSize(1, sizeof(Acc)); break;
+            case TileMode::L2: blockSize = CacheInfo::blockSize(2, sizeof(Acc)); break;
+            case TileMode::L3: blockSize = CacheInfo::blockSize(3, sizeof(Acc)); break;
+            case TileMode::WorkStealing:
+                // Start from an L2 sized tile but keep halving until there
+                // are enough tiles for stealing to even out the load.
+                blockSize = CacheInfo::blockSize(2, sizeof(Acc));
+                while(blockSize > 8) {
+                    uint64_t edgeTiles = (size + blockSize - 1) / blockSize;
+                    if(edgeTiles * edgeTiles >= 4 * static_cast<uint64_t>(numThreads)) { break; }
+                    blockSize /= 2;
+                }
+                break;
+            default: break;
+        }
 
         // Perform matrix multiplication and measure the time taken
+        PerfCounters::start();
         auto start = std::chrono::high_resolution_clock::now();
 
-        std::vector<std::thread> multThreads;
-        for(int th = 0; th < numThreads; th++) {
-            uint64_t startRow = th * rowsPerThread;
-            // If we're at the last thread let it handle the rest
-            // of the array, no matter the size.
-            uint64_t endRow = (th == numThreads - 1) ? size : startRow + rowsPerThread;
-            multThreads.emplace_back(multiplyMatrix, v1, v2, v3, size, startRow, endRow);
+        if(mode == TileMode::Transposed) {
+            // Transpose in bands of the transpose's rows, then multiply in
+            // bands of the result's rows.
+            Matrix<T> v2t(size);
+            pool.parallelFor(0, size, [&](uint64_t startRow, uint64_t endRow) {
+                Transpose::transposeRows(v2, v2t, startRow, endRow);
+            });
+            pool.parallelFor(0, size, [&](uint64_t startRow, uint64_t endRow) {
+                multiplyMatrixTransposed(v1, v2t, v3, startRow, endRow);
+            });
+        } else if(mode == TileMode::WorkStealing) {
+            WorkStealing::Stats result = WorkStealing::multiplyMatrix(v1, v2, v3, pool, blockSize);
+            if(stats != nullptr) { *stats = result; }
+        } else {
+            // Each pool thread takes a contiguous band of rows, the
+            // last one also handles the remainder.
+            pool.parallelFor(0, size, [&](uint64_t startRow, uint64_t endRow) {
+                if(mode == TileMode::None) {
+                    multiplyMatrix(v1, v2, v3, startRow, endRow);
+                } else {
+                    multiplyMatrixTiled(v1, v2, v3, startRow, endRow, blockSize);
+                }
+            });
         }
 
-        for(auto& t : multThreads) { t.join(); }
-
         auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
 
         auto duration = std::chrono::duration_cast
                         <std::chrono::microseconds>(end - start);
 
-        std::cout << "Parallel Multiplication took: " << duration.count() << " microseconds" << std::endl;
+        std::cout << "Parallel Multiplication took: " << duration.count() << " microseconds";
+        if(blockSize != 0) { std::cout << ", with block size: " << blockSize; }
+        std::cout << std::endl;
 
-        // Check if the results are correct
-        for(int i = 0; i < size; i++)
-        {
-            for (int j = 0; j < size; j++)
-            {
-                int result = 0;
-                for(int k = 0; k < size; k++)
-                {
-                    result += v1[i][k] * v2[k][j];
-                }
-                if(v3[i][j] != result)
-                {
-                    std::cout << "Error, value is not correct at: [" << i << ", " << j << "]" << std::endl;
-                    std::cout << "result: " << result << ", expected: " << v3[i][j] << std::endl;
-
-                    // Throw exception and stop program running if there's
-                    // any calculation is not correct.
-                    throw std::runtime_error("Result is incorrect.");
-                }
-            }
-        }
+        // Check the result, timed separately from the multiplication
+        Verification::verify(v1, v2, v3);
 
-        // Memory deallocation
-        for(uint64_t i = 0; i < size; i++) {
-            delete[] v1[i];
-            delete[] v2[i];
-            delete[] v3[i];
+        if(Affinity::enabled()) {
+            Affinity::printPlacement("v1", v1.data(), v1.rows() * v1.stride() * sizeof(T));
+            Affinity::printPlacement("v3", v3.data(), v3.rows() * v3.stride() * sizeof(Acc));
         }
-        delete[] v1;
-        delete[] v2;
-        delete[] v3;
 
         return duration.count();
     }
-};
+
+    // Explicit instantiations for every supported element type. Every
+    // accumulator type is also a storage type, so printMatrix covers both.
+#define INSTANTIATE(name, T, Acc) \
+    template void printMatrix<T>(const Matrix<T> &); \
+    template void randomMatrix<T>(Matrix<T> &, uint64_t, int, int, ThreadPool &); \
+    template void multiplyMatrix<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, uint64_t, uint64_t); \
+    template void multiplyMatrixTransposed<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, \
+                                                   uint64_t, uint64_t); \
+    template void multiplyMatrixTiled<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, \
+                                              uint64_t, uint64_t, uint64_t); \
+    template uint64_t run<T, Acc>(uint64_t, int, TileMode, bool, WorkStealing::Stats *);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
\ No newline at end of file
@@ -4,13 +4,39 @@
 #include <iostream>
 #include <random>
 
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include "WorkStealing.h"
+
 namespace ParallelMultiplication
 {
-    void printMatrix(uint64_t **matrix,  uint64_t size);
-    void randomMatrix(uint64_t **matrix,  uint64_t size,
-                      int low, int high);
-    void multiplyMatrix(uint64_t **m1, uint64_t **m2, uint64_t **m3, uint64_t size, uint64_t startRow, uint64_t endRow);
-    uint64_t run(uint64_t size, int numThreads);
+    /**
+     * How run() computes the product. None and the L1-L3 modes give each
+     * thread a band of rows, the tiled modes block the i-k-j loops so one
+     * tile of each operand fits in the given cache level. WorkStealing
+     * schedules 2D output tiles across threads with work-stealing deques.
+     * Transposed gives each thread a band of rows like None, but transposes
+     * the second matrix first so the inner loop is a unit-stride dot product.
+     */
+    enum class TileMode { None, L1, L2, L3, WorkStealing, Transposed };
+
+    ThreadPool &getPool(int numThreads, bool pin = false);
+    template <typename T>
+    void printMatrix(const Matrix<T> &matrix);
+    template <typename T>
+    void randomMatrix(Matrix<T> &matrix, uint64_t seed, int low, int high, ThreadPool &pool);
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                        uint64_t startRow, uint64_t endRow);
+    template <typename T, typename Acc>
+    void multiplyMatrixTransposed(const Matrix<T> &m1, const Matrix<T> &m2t, Matrix<Acc> &m3,
+                                  uint64_t startRow, uint64_t endRow);
+    template <typename T, typename Acc>
+    void multiplyMatrixTiled(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                             uint64_t startRow, uint64_t endRow, uint64_t blockSize);
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(uint64_t size, int numThreads, TileMode mode = TileMode::None, bool pinThreads = false,
+                 WorkStealing::Stats *stats = nullptr);
 
 }
 
@@ -0,0 +1,224 @@
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace PerfCounters
+{
+    bool countersEnabled = true;
+    std::string reason;
+    Counts lastCounts = [] { Counts counts; counts.fill(-1); return counts; }();
+
+    /**
+     * The counters opened on one thread. events[i] is the Event whose value
+     * is i-th in the group read, fds[0] is the group leader.
+     */
+    struct Group
+    {
+        std::vector<int> fds;
+        std::vector<Event> events;
+    };
+
+    std::vector<Group> groups;
+    // Threads the groups were opened on, see stop().
+    std::vector<pid_t> countedThreads;
+    // Events that could not be counted on at least one thread.
+    std::array<bool, NumEvents> missing{};
+
+    const char *name(Event event)
+    {
+        switch(event)
+        {
+            case Cycles: return "cycles";
+            case Instructions: return "instructions";
+            case L1DMisses: return "l1d_misses";
+            case LLCMisses: return "llc_misses";
+            case DTLBMisses: return "dtlb_misses";
+            case BranchMisses: return "branch_misses";
+            default: return "unknown";
+        }
+    }
+
+    /**
+     * Turn counting off, e.g. from --counters off.
+     */
+    void setEnabled(bool enabled) { countersEnabled = enabled; }
+
+    perf_event_attr attributes(Event event)
+    {
+        auto cache = [](uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch(event)
+        {
+            case Cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case Instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case BranchMisses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            case L1DMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = cache(PERF_COUNT_HW_CACHE_L1D); break;
+            case LLCMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = cache(PERF_COUNT_HW_CACHE_LL); break;
+            case DTLBMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = cache(PERF_COUNT_HW_CACHE_DTLB); break;
+            default: break;
+        }
+        // User space only, which perf_event_paranoid 2 still allows.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return attr;
+    }
+
+    /**
+     * Open a group on one thread. Members the CPU does not support are left
+     * out, the group is empty if not even the leader could be opened.
+     */
+    Group openGroup(pid_t tid)
+    {
+        Group group;
+        for(int event = 0; event < NumEvents; event++) {
+            perf_event_attr attr = attributes(static_cast<Event>(event));
+            attr.disabled = group.fds.empty() ? 1 : 0;
+            const int leader = group.fds.empty() ? -1 : group.fds[0];
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, leader, 0));
+            if(fd < 0) {
+                if(group.fds.empty() && reason.empty()) {
+                    reason = std::string(name(static_cast<Event>(event))) + ": " + std::strerror(errno);
+                }
+                continue;
+            }
+            group.fds.push_back(fd);
+            group.events.push_back(static_cast<Event>(event));
+        }
+        return group;
+    }
+
+    /**
+     * Thread ids of every thread in this process.
+     */
+    std::vector<pid_t> threads()
+    {
+        std::vector<pid_t> tids;
+        DIR *dir = opendir("/proc/self/task");
+        if(dir == nullptr) { return {static_cast<pid_t>(syscall(SYS_gettid))}; }
+        while(dirent *entry = readdir(dir)) {
+            if(entry->d_name[0] != '.') { tids.push_back(static_cast<pid_t>(std::atoi(entry->d_name))); }
+        }
+        closedir(dir);
+        return tids;
+    }
+
+    /**
+     * Whether at least some counters can be opened. Probed once, on the calling thread.
+     */
+    bool available()
+    {
+        static const bool probed = [] {
+            Group group = openGroup(0);
+            for(int fd : group.fds) { close(fd); }
+            return !group.fds.empty();
+        }();
+        return countersEnabled && probed;
+    }
+
+    const std::string &unavailableReason()
+    {
+        available();
+        if(!countersEnabled) {
+            static const std::string disabled = "disabled";
+            return disabled;
+        }
+        return reason;
+    }
+
+    /**
+     * Open and start counter groups on every thread that exists now. Pool
+     * and OMP threads are usually created before the timed region. Threads
+     * that are not, e.g. nested OMP teams, are not counted and stop()
+     * reports the run as unavailable. So are events that could not be
+     * opened on every thread.
+     */
+    void start()
+    {
+        lastCounts.fill(-1);
+        countedThreads.clear();
+        missing.fill(false);
+        if(!available()) { return; }
+
+        countedThreads = threads();
+        for(pid_t tid : countedThreads) {
+            Group group = openGroup(tid);
+            for(int event = 0; event < NumEvents; event++) {
+                if(std::find(group.events.begin(), group.events.end(), event) == group.events.end()) {
+                    missing[event] = true;
+                }
+            }
+            if(!group.fds.empty()) { groups.push_back(std::move(group)); }
+        }
+        for(const Group &group : groups) {
+            ioctl(group.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(group.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    /**
+     * Stop every group and sum the counts into last(). Counts are scaled up
+     * if the kernel had to multiplex the group. An event missing from any
+     * thread's group, or from any read, is reported as -1 rather than as a
+     * partial total. So is every event if threads were created since
+     * start(), as their work is missing from the groups.
+     */
+    void stop()
+    {
+        if(groups.empty()) { return; }
+        lastCounts.fill(0);
+        for(const Group &group : groups) {
+            ioctl(group.fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+
+        for(const Group &group : groups) {
+            // nr, time enabled, time running, then one value per member.
+            std::vector<uint64_t> buffer(3 + NumEvents, 0);
+            const ssize_t bytes = read(group.fds[0], buffer.data(), buffer.size() * sizeof(uint64_t));
+            if(bytes < static_cast<ssize_t>((3 + group.events.size()) * sizeof(uint64_t))
+               || (buffer[1] != 0 && buffer[2] == 0)) {
+                // The group could not be read, or was never given a counter.
+                for(Event event : group.events) { missing[event] = true; }
+            } else if(buffer[2] != 0) {
+                // A thread that slept throughout adds nothing.
+                const double scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+                for(size_t i = 0; i < group.events.size() && i < buffer[0]; i++) {
+                    lastCounts[group.events[i]] += static_cast<int64_t>(static_cast<double>(buffer[3 + i]) * scale);
+                }
+            }
+            for(int fd : group.fds) { close(fd); }
+        }
+        groups.clear();
+
+        for(int event = 0; event < NumEvents; event++) {
+            if(missing[event]) { lastCounts[event] = -1; }
+        }
+
+        for(pid_t tid : threads()) {
+            if(std::find(countedThreads.begin(), countedThreads.end(), tid) == countedThreads.end()) {
+                lastCounts.fill(-1);
+                break;
+            }
+        }
+    }
+
+    /**
+     * Counts from the most recent start()/stop() pair.
+     */
+    const Counts &last() { return lastCounts; }
+};
@@ -0,0 +1,37 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/**
+ * Hardware performance counters around the timed part of each run().
+ *
+ * start() opens a perf_event_open group (cycles, instructions, L1D, LLC
+ * and dTLB read misses, branch misses) on every thread of the process and
+ * stop() sums them. Counters that the kernel or the CPU refuses, e.g. under
+ * perf_event_paranoid or in a VM without a PMU, are reported as -1 and the
+ * run carries on without them.
+ */
+namespace PerfCounters
+{
+    enum Event { Cycles, Instructions, L1DMisses, LLCMisses, DTLBMisses, BranchMisses, NumEvents };
+
+    /**
+     * Count per event, -1 where the event could not be counted.
+     */
+    using Counts = std::array<int64_t, NumEvents>;
+
+    const char *name(Event event);
+    void setEnabled(bool enabled);
+    bool available();
+    const std::string &unavailableReason();
+
+    void start();
+    void stop();
+    const Counts &last();
+}
+
+
+#endif
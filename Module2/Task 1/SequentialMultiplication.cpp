@@ -1,20 +1,26 @@
 #include "SequentialMultiplication.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+#include "Transpose.h"
 
 #include <random>
 #include <chrono>
 
 namespace SequentialMultiplication
 {
-    void printMatrix(int **matrix, const uint64_t size) {
+    template <typename T>
+    void printMatrix(const Matrix<T> &matrix) {
         std::string mat;
-        for(uint64_t i = 0; i < size; i++) {
+        for(uint64_t i = 0; i < matrix.rows(); i++) {
             mat += "[";
-            for(uint64_t j = 0; j < size; j++) {
+            for(uint64_t j = 0; j < matrix.cols(); j++) {
                 if(j == 0) {
-                    mat += std::to_string(matrix[i][j]);
+                    mat += std::to_string(matrix(i, j));
                 } else {
                     mat += ", ";
-                    mat += std::to_string(matrix[i][j]);
+                    mat += std::to_string(matrix(i, j));
                 }
             }
             mat += "]\n";
@@ -25,94 +31,114 @@ namespace SequentialMultiplication
     /**
      * Initialize the given matrix with random values.
      * @param matrix: The matrix to be initialized.
-     * @param size: The size of the matrix (assumed to be square).
-     * @param rng: Random number generator.
+     * @param seed: Seed of the counter-based generator.
      * @param low: Lower bound for random values.
      * @param high: Upper bound for random values.
      */
-    void randomMatrix(int **matrix, const uint64_t size, std::mt19937 &rng,
+    template <typename T>
+    void randomMatrix(Matrix<T> &matrix, uint64_t seed,
                       int low, int high)
     {
-        std::uniform_int_distribution<int> dist(low, high);
-        for(uint64_t i = 0; i < size; i++) {
-            for(uint64_t j = 0; j < size; j++) {
-                matrix[i][j] = dist(rng);
+        CounterRandom::fillRows(matrix, seed, low, high, 0, matrix.rows());
+    }
+
+    /**
+     * Multiply two matrices and store the result in a third matrix.
+     * Products are summed in the accumulator type Acc.
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Matrix to store the result.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3)
+    {
+        const uint64_t inner = m1.cols();
+        for(uint64_t row = 0; row < m3.rows(); row++) {
+            const T *a = m1.row(row);
+            Acc *c = m3.row(row);
+            for(uint64_t col = 0; col < m3.cols(); col++) {
+                Acc sum = 0;
+                for(uint64_t i = 0; i < inner; i++) {
+                    sum += static_cast<Acc>(a[i]) * static_cast<Acc>(m2(i, col));
+                }
+                c[col] = sum;
+            }
+        }
+    }
+
+    /**
+     * Multiply m1 by a matrix given as its transpose, so every element is
+     * a dot product of two unit-stride rows.
+     * @param m1: First matrix.
+     * @param m2t: Transpose of the second matrix.
+     * @param m3: Matrix to store the result.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrixTransposed(const Matrix<T> &m1, const Matrix<T> &m2t, Matrix<Acc> &m3)
+    {
+        const uint64_t inner = m1.cols();
+        for(uint64_t row = 0; row < m3.rows(); row++) {
+            const T *a = m1.row(row);
+            Acc *c = m3.row(row);
+            for(uint64_t col = 0; col < m3.cols(); col++) {
+                c[col] = Transpose::dot<T, Acc>(a, m2t.row(col), inner);
             }
         }
     }
 
     /**
      * Run matrix multiplication for matrices of given size.
+     * @tparam T: Storage type of the input matrices.
+     * @tparam Acc: Accumulator and result type.
      * @param size: The size of the matrices (assumed to be square).
+     * @param transposeB: Transpose the second matrix first, the transpose is timed too.
      * @return Duration taken for the multiplication operation.
      */
-    uint64_t run(const uint64_t size) {
-
-        std:: random_device rd;
-        std::mt19937 rng(rd());
-
-        int **v1, **v2, **v3;
+    template <typename T, typename Acc>
+    uint64_t run(const uint64_t size, bool transposeB) {
 
         // Memory allocation for matrices
-        v1 = new int*[size];
-        v2 = new int*[size];
-        v3 = new int*[size];
-        for(uint64_t i = 0; i < size; i++){
-            v1[i] = new int[size];
-            v2[i] = new int[size];
-            v3[i] = new int[size];
-        }
+        Matrix<T> v1(size), v2(size);
+        Matrix<Acc> v3(size);
 
         // Initialize matrices with random values
-        randomMatrix(v1, size, rng, 1, 10);
-        randomMatrix(v2, size, rng, 1, 10);
+        randomMatrix(v1, CounterRandom::streamSeed(0), 1, 10);
+        randomMatrix(v2, CounterRandom::streamSeed(1), 1, 10);
         // Perform matrix multiplication and measure the time taken
+        PerfCounters::start();
         auto start = std::chrono::high_resolution_clock::now();
 
-        for(uint64_t row = 0; row < size; row++) {
-            for(uint64_t col = 0; col < size; col++) {
-                v3[row][col] = 0;
-                for(uint64_t i = 0; i < size; i++) {
-                    v3[row][col] += v1[row][i] * v2[i][col];
-                }
-            }
+        if(transposeB) {
+            Matrix<T> v2t(size);
+            Transpose::transposeRows(v2, v2t, 0, size);
+            multiplyMatrixTransposed(v1, v2t, v3);
+        } else {
+            multiplyMatrix(v1, v2, v3);
         }
 
         auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
 
         auto duration = std::chrono::duration_cast
                         <std::chrono::microseconds>(end - start);
 
-        std::cout << "Sequential Multiplication took: " << duration.count() << " microseconds" << std::endl;
+        std::cout << (transposeB ? "Sequential Transposed Multiplication took: " : "Sequential Multiplication took: ")
+                  << duration.count() << " microseconds" << std::endl;
 
-        // Check if the results are correct
-        for(int i = 0; i < size; i++) {
-            for (int j = 0; j < size; j++) {
-                int result = 0;
-                for(int k = 0; k < size; k++) {
-                    result += v1[i][k] * v2[k][j];
-                }
-                if(v3[i][j] != result) {
-                    std::cout << "Error, value is not correct at: [" << i << ", " << j << "]" << std::endl;
-                    std::cout << "result: " << result << ", expected: " << v3[i][j] << std::endl;
-
-                    // Throw exception and stop program running if there's
-                    // any calculation is not correct.
-                    throw std::runtime_error("Result is incorrect.");
-                }
-            }
-        }
-
-        // Memory deallocation
-        for(uint64_t i = 0; i < size; i++) {
-            delete[] v1[i];
-            delete[] v2[i];
-            delete[] v3[i];
-        }
-        delete[] v1;
-        delete[] v2;
-        delete[] v3;
+        // Check the result, timed separately from the multiplication
+        Verification::verify(v1, v2, v3);
 
         return duration.count();
     }
-};
+
+    // Explicit instantiations for every supported element type. Every
+    // accumulator type is also a storage type, so printMatrix covers both.
+#define INSTANTIATE(name, T, Acc) \
+    template void printMatrix<T>(const Matrix<T> &); \
+    template void randomMatrix<T>(Matrix<T> &, uint64_t, int, int); \
+    template void multiplyMatrix<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &); \
+    template void multiplyMatrixTransposed<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &); \
+    template uint64_t run<T, Acc>(uint64_t, bool);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
\ No newline at end of file
@@ -4,12 +4,21 @@
 #include <iostream>
 #include <random>
 
+#include "Matrix.h"
+
 namespace SequentialMultiplication
 {
-    void printMatrix(int **matrix,  uint64_t size);
-    void randomMatrix(int **matrix,  uint64_t size, std::mt19937 &rng,
+    template <typename T>
+    void printMatrix(const Matrix<T> &matrix);
+    template <typename T>
+    void randomMatrix(Matrix<T> &matrix, uint64_t seed,
                       int low, int high);
-    uint64_t run(uint64_t size);
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3);
+    template <typename T, typename Acc>
+    void multiplyMatrixTransposed(const Matrix<T> &m1, const Matrix<T> &m2t, Matrix<Acc> &m3);
+    template <typename T = int, typename Acc = T>
+    uint64_t run(uint64_t size, bool transposeB = false);
 
 }
 
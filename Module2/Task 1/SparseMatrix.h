@@ -0,0 +1,43 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Compressed sparse row storage.
+ *
+ * The non-zeros of row i are values[rowPtr[i] .. rowPtr[i + 1]), in column
+ * order, with their columns in colIdx. rowPtr has rows + 1 entries, the
+ * last one is the number of non-zeros.
+ */
+template <typename T>
+struct CSR
+{
+    uint64_t rows = 0;
+    uint64_t cols = 0;
+    std::vector<uint64_t> rowPtr;
+    std::vector<uint64_t> colIdx;
+    std::vector<T> values;
+
+    uint64_t nonZeros() const { return values.size(); }
+};
+
+/**
+ * Compressed sparse column storage, CSR of the transpose: the non-zeros of
+ * column j are values[colPtr[j] .. colPtr[j + 1]), in row order.
+ */
+template <typename T>
+struct CSC
+{
+    uint64_t rows = 0;
+    uint64_t cols = 0;
+    std::vector<uint64_t> colPtr;
+    std::vector<uint64_t> rowIdx;
+    std::vector<T> values;
+
+    uint64_t nonZeros() const { return values.size(); }
+};
+
+
+#endif
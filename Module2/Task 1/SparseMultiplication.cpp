@@ -0,0 +1,346 @@
+#include "SparseMultiplication.h"
+#include "OMPParallelMultiplication.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <omp.h>
+
+namespace SparseMultiplication
+{
+    std::string lastKernelName;
+
+    /**
+     * Fraction of the elements that are non-zero.
+     * @param matrix: The matrix to measure.
+     * @param numThreads: Number of threads to count with.
+     */
+    template <typename T>
+    double density(const Matrix<T> &matrix, int numThreads)
+    {
+        const uint64_t rows = matrix.rows(), cols = matrix.cols();
+        if(rows == 0 || cols == 0) { return 0; }
+
+        uint64_t nonZeros = 0;
+        #pragma omp parallel for default(none) shared(matrix) firstprivate(rows, cols) reduction(+:nonZeros) num_threads(numThreads)
+        for(uint64_t i = 0; i < rows; i++) {
+            const T *row = matrix.row(i);
+            for(uint64_t j = 0; j < cols; j++) { nonZeros += row[j] != T{0}; }
+        }
+        return static_cast<double>(nonZeros) / static_cast<double>(rows * cols);
+    }
+
+    /**
+     * Compress a dense matrix: count each row's non-zeros, prefix sum the
+     * counts into row offsets, then copy every row into its slot.
+     */
+    template <typename T>
+    CSR<T> toCSR(const Matrix<T> &matrix, int numThreads)
+    {
+        CSR<T> csr;
+        csr.rows = matrix.rows();
+        csr.cols = matrix.cols();
+        csr.rowPtr.assign(csr.rows + 1, 0);
+        const uint64_t rows = csr.rows, cols = csr.cols;
+
+        #pragma omp parallel for default(none) shared(matrix, csr) firstprivate(rows, cols) num_threads(numThreads)
+        for(uint64_t i = 0; i < rows; i++) {
+            const T *row = matrix.row(i);
+            uint64_t count = 0;
+            for(uint64_t j = 0; j < cols; j++) { count += row[j] != T{0}; }
+            csr.rowPtr[i + 1] = count;
+        }
+        for(uint64_t i = 0; i < rows; i++) { csr.rowPtr[i + 1] += csr.rowPtr[i]; }
+
+        csr.colIdx.resize(csr.rowPtr[rows]);
+        csr.values.resize(csr.rowPtr[rows]);
+        #pragma omp parallel for default(none) shared(matrix, csr) firstprivate(rows, cols) num_threads(numThreads)
+        for(uint64_t i = 0; i < rows; i++) {
+            const T *row = matrix.row(i);
+            uint64_t out = csr.rowPtr[i];
+            for(uint64_t j = 0; j < cols; j++) {
+                if(row[j] != T{0}) {
+                    csr.colIdx[out] = j;
+                    csr.values[out++] = row[j];
+                }
+            }
+        }
+        return csr;
+    }
+
+    /**
+     * Convert CSR to CSC with a counting sort on the column index. Rows are
+     * visited in order, so every column comes out sorted by row.
+     */
+    template <typename T>
+    CSC<T> toCSC(const CSR<T> &matrix)
+    {
+        CSC<T> csc;
+        csc.rows = matrix.rows;
+        csc.cols = matrix.cols;
+        csc.colPtr.assign(csc.cols + 1, 0);
+        csc.rowIdx.resize(matrix.nonZeros());
+        csc.values.resize(matrix.nonZeros());
+
+        for(uint64_t col : matrix.colIdx) { csc.colPtr[col + 1]++; }
+        for(uint64_t j = 0; j < csc.cols; j++) { csc.colPtr[j + 1] += csc.colPtr[j]; }
+
+        std::vector<uint64_t> next(csc.colPtr.begin(), csc.colPtr.end() - 1);
+        for(uint64_t i = 0; i < matrix.rows; i++) {
+            for(uint64_t p = matrix.rowPtr[i]; p < matrix.rowPtr[i + 1]; p++) {
+                const uint64_t out = next[matrix.colIdx[p]]++;
+                csc.rowIdx[out] = i;
+                csc.values[out] = matrix.values[p];
+            }
+        }
+        return csc;
+    }
+
+    /**
+     * Expand a CSR matrix into a dense one of the same shape.
+     */
+    template <typename T>
+    void toDense(const CSR<T> &matrix, Matrix<T> &dense, int numThreads)
+    {
+        const uint64_t rows = matrix.rows, cols = matrix.cols;
+        #pragma omp parallel for default(none) shared(matrix, dense) firstprivate(rows, cols) num_threads(numThreads)
+        for(uint64_t i = 0; i < rows; i++) {
+            T *row = dense.row(i);
+            std::fill(row, row + cols, T{0});
+            for(uint64_t p = matrix.rowPtr[i]; p < matrix.rowPtr[i + 1]; p++) {
+                row[matrix.colIdx[p]] = matrix.values[p];
+            }
+        }
+    }
+
+    /**
+     * Sparse x dense. Each non-zero m1(i, k) adds m1(i, k) * row k of m2 to
+     * row i of m3, so m2 is only read along rows.
+     * @param m1: First matrix, in CSR.
+     * @param m2: Second matrix, dense.
+     * @param m3: Receives the dense product.
+     * @param numThreads: Number of threads to use for parallelism.
+     */
+    template <typename T, typename Acc>
+    void multiplySpMM(const CSR<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3, int numThreads)
+    {
+        const uint64_t rows = m1.rows, cols = m2.cols();
+        #pragma omp parallel for default(none) shared(m1, m2, m3) firstprivate(rows, cols) num_threads(numThreads) schedule(dynamic, 16)
+        for(uint64_t i = 0; i < rows; i++) {
+            Acc *c = m3.row(i);
+            std::fill(c, c + cols, Acc{0});
+            for(uint64_t p = m1.rowPtr[i]; p < m1.rowPtr[i + 1]; p++) {
+                const Acc a = m1.values[p];
+                const T *b = m2.row(m1.colIdx[p]);
+                for(uint64_t j = 0; j < cols; j++) {
+                    c[j] += a * static_cast<Acc>(b[j]);
+                }
+            }
+        }
+    }
+
+    /**
+     * Dense x sparse. Element (i, j) is the dot product of row i of m1 with
+     * the non-zeros of column j of m2, which CSC stores contiguously.
+     * @param m1: First matrix, dense.
+     * @param m2: Second matrix, in CSC.
+     * @param m3: Receives the dense product.
+     * @param numThreads: Number of threads to use for parallelism.
+     */
+    template <typename T, typename Acc>
+    void multiplyDenseCSC(const Matrix<T> &m1, const CSC<T> &m2, Matrix<Acc> &m3, int numThreads)
+    {
+        const uint64_t rows = m1.rows(), cols = m2.cols;
+        #pragma omp parallel for default(none) shared(m1, m2, m3) firstprivate(rows, cols) num_threads(numThreads) schedule(dynamic, 16)
+        for(uint64_t i = 0; i < rows; i++) {
+            const T *a = m1.row(i);
+            Acc *c = m3.row(i);
+            for(uint64_t j = 0; j < cols; j++) {
+                Acc sum = 0;
+                for(uint64_t p = m2.colPtr[j]; p < m2.colPtr[j + 1]; p++) {
+                    sum += static_cast<Acc>(a[m2.rowIdx[p]]) * static_cast<Acc>(m2.values[p]);
+                }
+                c[j] = sum;
+            }
+        }
+    }
+
+    /**
+     * Sparse x sparse with Gustavson's row-by-row algorithm. A symbolic pass
+     * counts the non-zeros of every result row, so the numeric pass can write
+     * each row straight into its final slot. Each thread keeps a dense
+     * accumulator and a marker per column, reset lazily by row number.
+     * @param m1: First matrix, in CSR.
+     * @param m2: Second matrix, in CSR.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @return The product, in CSR with sorted columns.
+     */
+    template <typename T, typename Acc>
+    CSR<Acc> multiplySpGEMM(const CSR<T> &m1, const CSR<T> &m2, int numThreads)
+    {
+        CSR<Acc> m3;
+        m3.rows = m1.rows;
+        m3.cols = m2.cols;
+        m3.rowPtr.assign(m3.rows + 1, 0);
+        const uint64_t rows = m3.rows, cols = m3.cols;
+
+        #pragma omp parallel default(none) shared(m1, m2, m3) firstprivate(rows, cols) num_threads(numThreads)
+        {
+            std::vector<uint64_t> marker(cols, UINT64_MAX);
+
+            #pragma omp for schedule(dynamic, 16)
+            for(uint64_t i = 0; i < rows; i++) {
+                uint64_t count = 0;
+                for(uint64_t p = m1.rowPtr[i]; p < m1.rowPtr[i + 1]; p++) {
+                    const uint64_t k = m1.colIdx[p];
+                    for(uint64_t q = m2.rowPtr[k]; q < m2.rowPtr[k + 1]; q++) {
+                        const uint64_t j = m2.colIdx[q];
+                        if(marker[j] != i) {
+                            marker[j] = i;
+                            count++;
+                        }
+                    }
+                }
+                m3.rowPtr[i + 1] = count;
+            }
+
+            #pragma omp single
+            {
+                for(uint64_t i = 0; i < rows; i++) { m3.rowPtr[i + 1] += m3.rowPtr[i]; }
+                m3.colIdx.resize(m3.rowPtr[rows]);
+                m3.values.resize(m3.rowPtr[rows]);
+            }
+
+            // The same row can land on another thread in this pass, so the
+            // markers from the symbolic pass cannot be trusted.
+            std::fill(marker.begin(), marker.end(), UINT64_MAX);
+            std::vector<Acc> accumulator(cols);
+            std::vector<uint64_t> touched;
+
+            #pragma omp for schedule(dynamic, 16)
+            for(uint64_t i = 0; i < rows; i++) {
+                touched.clear();
+                for(uint64_t p = m1.rowPtr[i]; p < m1.rowPtr[i + 1]; p++) {
+                    const Acc a = m1.values[p];
+                    const uint64_t k = m1.colIdx[p];
+                    for(uint64_t q = m2.rowPtr[k]; q < m2.rowPtr[k + 1]; q++) {
+                        const uint64_t j = m2.colIdx[q];
+                        if(marker[j] != i) {
+                            marker[j] = i;
+                            accumulator[j] = 0;
+                            touched.push_back(j);
+                        }
+                        accumulator[j] += a * static_cast<Acc>(m2.values[q]);
+                    }
+                }
+
+                std::sort(touched.begin(), touched.end());
+                uint64_t out = m3.rowPtr[i];
+                for(uint64_t j : touched) {
+                    m3.colIdx[out] = j;
+                    m3.values[out++] = accumulator[j];
+                }
+            }
+        }
+        return m3;
+    }
+
+    /**
+     * Kernel picked by the last run(): spgemm, spmm, dense_csc or dense.
+     */
+    const std::string &lastKernel() { return lastKernelName; }
+
+    /**
+     * Fill a matrix with the given fraction of non-zeros.
+     */
+    template <typename T>
+    void sparseMatrix(Matrix<T> &matrix, uint64_t seed, double density, int numThreads)
+    {
+        const uint64_t rows = matrix.rows();
+        #pragma omp parallel for default(none) shared(matrix) firstprivate(rows, seed, density) num_threads(numThreads)
+        for(uint64_t i = 0; i < rows; i++) {
+            CounterRandom::fillSparseRows(matrix, seed, 1, 10, density, i, i + 1);
+        }
+    }
+
+    /**
+     * Run the multiplication of two random sparse matrices, dispatching on
+     * their measured density. Measuring, compressing and expanding the
+     * result back to dense are all part of the timed region.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param density1: Fraction of non-zeros in the first matrix.
+     * @param density2: Fraction of non-zeros in the second matrix.
+     * @return Duration taken for the multiplication operation.
+     */
+    template <typename T, typename Acc>
+    uint64_t run(const uint64_t size, int numThreads, double density1, double density2)
+    {
+        // Initialize matrices
+        Matrix<T> v1(size), v2(size);
+        Matrix<Acc> v3(size);
+
+        // Fill matrices with random values at the requested densities
+        sparseMatrix(v1, CounterRandom::streamSeed(0), density1, numThreads);
+        sparseMatrix(v2, CounterRandom::streamSeed(1), density2, numThreads);
+
+        // The dense fallback runs the OMP kernel with the auto schedule. Set
+        // it here, outside the timing, the way OMPParallelMultiplication::run does.
+        OMPParallelMultiplication::setSchedule(0, 0);
+
+        // Perform matrix multiplication and measure the time taken
+        PerfCounters::start();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const double measured1 = density(v1, numThreads);
+        const double measured2 = density(v2, numThreads);
+        if(measured1 < sparseThreshold && measured2 < sparseThreshold) {
+            lastKernelName = "spgemm";
+            const CSR<Acc> product = multiplySpGEMM<T, Acc>(toCSR(v1, numThreads), toCSR(v2, numThreads), numThreads);
+            toDense(product, v3, numThreads);
+        } else if(measured1 < sparseThreshold) {
+            lastKernelName = "spmm";
+            multiplySpMM(toCSR(v1, numThreads), v2, v3, numThreads);
+        } else if(measured2 < sparseThreshold) {
+            lastKernelName = "dense_csc";
+            multiplyDenseCSC(v1, toCSC(toCSR(v2, numThreads)), v3, numThreads);
+        } else {
+            lastKernelName = "dense";
+            Matrix<T> v2t(size);
+            OMPParallelMultiplication::transposeMatrix(v2, v2t, numThreads);
+            OMPParallelMultiplication::multiplyMatrixTransposed(v1, v2t, v3, numThreads);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
+
+        auto duration = std::chrono::duration_cast
+                        <std::chrono::microseconds>(end - start);
+
+        std::cout << "Sparse Multiplication (" << lastKernelName << ") took: " << duration.count()
+                  << " microseconds, at densities " << measured1 << " x " << measured2 << std::endl;
+
+        // Check the result, timed separately from the multiplication
+        Verification::verify(v1, v2, v3);
+
+        return duration.count();
+    }
+
+    // Every accumulator type is also a storage type, so the single type
+    // conversions cover the CSR results of SpGEMM too.
+#define INSTANTIATE(name, T, Acc) \
+    template double density<T>(const Matrix<T> &, int); \
+    template CSR<T> toCSR<T>(const Matrix<T> &, int); \
+    template CSC<T> toCSC<T>(const CSR<T> &); \
+    template void toDense<T>(const CSR<T> &, Matrix<T> &, int); \
+    template void multiplySpMM<T, Acc>(const CSR<T> &, const Matrix<T> &, Matrix<Acc> &, int); \
+    template void multiplyDenseCSC<T, Acc>(const Matrix<T> &, const CSC<T> &, Matrix<Acc> &, int); \
+    template CSR<Acc> multiplySpGEMM<T, Acc>(const CSR<T> &, const CSR<T> &, int); \
+    template uint64_t run<T, Acc>(uint64_t, int, double, double);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
@@ -0,0 +1,50 @@
+#ifndef SPARSE_MULTIPLICATION_H
+#define SPARSE_MULTIPLICATION_H
+
+#include <iostream>
+#include <cstdint>
+#include <string>
+
+#include "Matrix.h"
+#include "SparseMatrix.h"
+
+/**
+ * Sparse engines and the density-based dispatch between them.
+ *
+ * run() counts the non-zeros of both operands and picks the kernel:
+ * SpGEMM (CSR x CSR) when both are sparse, SpMM (CSR x dense) when only
+ * the first is, dense x CSC when only the second is, and the transposed
+ * dense OMP kernel otherwise. All kernels split rows of the result between
+ * OMP threads with a dynamic schedule, since rows differ in non-zeros.
+ */
+namespace SparseMultiplication
+{
+    // Below this fraction of non-zeros an operand is multiplied in sparse
+    // form. The sparse kernels do density * n^3 work but with indirect
+    // loads; at n = 600 SpMM stops beating the transposed dense kernel
+    // at around 15%.
+    constexpr double sparseThreshold = 0.15;
+
+    template <typename T>
+    double density(const Matrix<T> &matrix, int numThreads);
+    template <typename T>
+    CSR<T> toCSR(const Matrix<T> &matrix, int numThreads);
+    template <typename T>
+    CSC<T> toCSC(const CSR<T> &matrix);
+    template <typename T>
+    void toDense(const CSR<T> &matrix, Matrix<T> &dense, int numThreads);
+
+    template <typename T, typename Acc>
+    void multiplySpMM(const CSR<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3, int numThreads);
+    template <typename T, typename Acc>
+    void multiplyDenseCSC(const Matrix<T> &m1, const CSC<T> &m2, Matrix<Acc> &m3, int numThreads);
+    template <typename T, typename Acc>
+    CSR<Acc> multiplySpGEMM(const CSR<T> &m1, const CSR<T> &m2, int numThreads);
+
+    const std::string &lastKernel();
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(uint64_t size, int numThreads, double density1, double density2);
+}
+
+
+#endif
@@ -0,0 +1,282 @@
+#include "StrassenMultiplication.h"
+#include "CacheInfo.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <omp.h>
+
+namespace StrassenMultiplication
+{
+    // Recursion levels that spawn the seven products as OMP tasks. 7^2 = 49
+    // tasks is plenty to keep a node busy, deeper levels run inside their task.
+    constexpr int taskDepth = 2;
+
+    /**
+     * A square block inside a larger row-major buffer.
+     */
+    struct View
+    {
+        uint64_t *data;
+        uint64_t stride;
+
+        uint64_t *row(uint64_t r) const { return data + r * stride; }
+        View quadrant(uint64_t half, int r, int c) const { return {data + r * half * stride + c * half, stride}; }
+    };
+
+    /**
+     * c = a + b over an n x n block.
+     */
+    void add(View a, View b, View c, uint64_t n)
+    {
+        for(uint64_t i = 0; i < n; i++) {
+            const uint64_t *ar = a.row(i), *br = b.row(i);
+            uint64_t *cr = c.row(i);
+            for(uint64_t j = 0; j < n; j++) { cr[j] = ar[j] + br[j]; }
+        }
+    }
+
+    /**
+     * c = a - b over an n x n block. Unsigned wrap-around is fine here, every
+     * difference is added back before it reaches the result.
+     */
+    void sub(View a, View b, View c, uint64_t n)
+    {
+        for(uint64_t i = 0; i < n; i++) {
+            const uint64_t *ar = a.row(i), *br = b.row(i);
+            uint64_t *cr = c.row(i);
+            for(uint64_t j = 0; j < n; j++) { cr[j] = ar[j] - br[j]; }
+        }
+    }
+
+    /**
+     * Base case: c = a * b with a cache-blocked i-k-j loop.
+     */
+    void multiplyBase(View a, View b, View c, uint64_t n)
+    {
+        static const uint64_t block = CacheInfo::blockSize(1, sizeof(uint64_t));
+
+        for(uint64_t i = 0; i < n; i++) { std::fill(c.row(i), c.row(i) + n, 0); }
+
+        for(uint64_t kk = 0; kk < n; kk += block) {
+            const uint64_t kEnd = std::min(kk + block, n);
+            for(uint64_t jj = 0; jj < n; jj += block) {
+                const uint64_t jEnd = std::min(jj + block, n);
+                for(uint64_t i = 0; i < n; i++) {
+                    const uint64_t *ar = a.row(i);
+                    uint64_t *cr = c.row(i);
+                    for(uint64_t k = kk; k < kEnd; k++) {
+                        const uint64_t aik = ar[k];
+                        const uint64_t *br = b.row(k);
+                        for(uint64_t j = jj; j < jEnd; j++) {
+                            cr[j] += aik * br[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Number of elements of workspace needed to multiply n x n blocks.
+     * Each level needs 15 half-size temporaries, task levels give every
+     * child its own workspace so the seven products can run concurrently.
+     */
+    uint64_t workspaceSize(uint64_t n, uint64_t cutoff, int depth)
+    {
+        if(n <= cutoff) { return 0; }
+        const uint64_t half = n / 2;
+        const uint64_t child = workspaceSize(half, cutoff, depth + 1);
+        return 15 * half * half + (depth < taskDepth ? 7 * child : child);
+    }
+
+    /**
+     * Strassen-Winograd step: c = a * b using 7 half-size products.
+     * @param workspace: Preallocated scratch space of workspaceSize(n) elements.
+     */
+    void recurse(View a, View b, View c, uint64_t n, uint64_t cutoff, int depth, uint64_t *workspace)
+    {
+        if(n <= cutoff) {
+            multiplyBase(a, b, c, n);
+            return;
+        }
+
+        const uint64_t h = n / 2;
+        const uint64_t block = h * h;
+        View t[15];
+        for(int i = 0; i < 15; i++) { t[i] = {workspace + i * block, h}; }
+        uint64_t *childSpace = workspace + 15 * block;
+        const uint64_t childSize = workspaceSize(h, cutoff, depth + 1);
+
+        View a11 = a.quadrant(h, 0, 0), a12 = a.quadrant(h, 0, 1), a21 = a.quadrant(h, 1, 0), a22 = a.quadrant(h, 1, 1);
+        View b11 = b.quadrant(h, 0, 0), b12 = b.quadrant(h, 0, 1), b21 = b.quadrant(h, 1, 0), b22 = b.quadrant(h, 1, 1);
+        View c11 = c.quadrant(h, 0, 0), c12 = c.quadrant(h, 0, 1), c21 = c.quadrant(h, 1, 0), c22 = c.quadrant(h, 1, 1);
+
+        View s1 = t[0], s2 = t[1], s3 = t[2], s4 = t[3];
+        View t1 = t[4], t2 = t[5], t3 = t[6], t4 = t[7];
+        View p[7] = {t[8], t[9], t[10], t[11], t[12], t[13], t[14]};
+
+        add(a21, a22, s1, h);
+        sub(s1, a11, s2, h);
+        sub(a11, a21, s3, h);
+        sub(a12, s2, s4, h);
+        sub(b12, b11, t1, h);
+        sub(b22, t1, t2, h);
+        sub(b22, b12, t3, h);
+        sub(t2, b21, t4, h);
+
+        const View lhs[7] = {a11, a12, s4, a22, s1, s2, s3};
+        const View rhs[7] = {b11, b21, b22, t4, t1, t2, t3};
+
+        if(depth < taskDepth) {
+            for(int i = 0; i < 7; i++) {
+                #pragma omp task default(none) firstprivate(i, h, cutoff, depth, childSpace, childSize) shared(lhs, rhs, p)
+                recurse(lhs[i], rhs[i], p[i], h, cutoff, depth + 1, childSpace + i * childSize);
+            }
+            #pragma omp taskwait
+        } else {
+            for(int i = 0; i < 7; i++) {
+                recurse(lhs[i], rhs[i], p[i], h, cutoff, depth + 1, childSpace);
+            }
+        }
+
+        // C11 = P1 + P2, U2 = P1 + P6, U3 = U2 + P7, U4 = U2 + P5
+        // C12 = U4 + P3, C21 = U3 - P4, C22 = U3 + P5
+        add(p[0], p[1], c11, h);
+        add(p[0], p[5], p[0], h);
+        add(p[0], p[6], p[6], h);
+        add(p[0], p[4], p[0], h);
+        add(p[0], p[2], c12, h);
+        sub(p[6], p[3], c21, h);
+        add(p[6], p[4], c22, h);
+    }
+
+    /**
+     * Multiply two square matrices with Strassen-Winograd recursion.
+     *
+     * Sizes that do not halve cleanly down to the cutoff are zero padded to
+     * the next size that does. All temporaries come from one workspace
+     * allocated up front, nothing is allocated inside the recursion.
+     *
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Matrix to store the result.
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param cutoff: Blocks this size or smaller use the classical base kernel.
+     */
+    void multiplyMatrix(const Matrix<uint64_t> &m1, const Matrix<uint64_t> &m2, Matrix<uint64_t> &m3,
+                        int numThreads, uint64_t cutoff)
+    {
+        const uint64_t n = m3.rows();
+        if(cutoff == 0) { cutoff = 1; }
+
+        // Pad up to leaf * 2^levels with leaf <= cutoff.
+        uint64_t leaf = n;
+        int levels = 0;
+        while(leaf > cutoff) {
+            leaf = (leaf + 1) / 2;
+            levels++;
+        }
+        const uint64_t padded = leaf << levels;
+
+        Matrix<uint64_t> pa, pb, pc;
+        View a{const_cast<uint64_t*>(m1.data()), m1.stride()};
+        View b{const_cast<uint64_t*>(m2.data()), m2.stride()};
+        View c{m3.data(), m3.stride()};
+        if(padded != n) {
+            pa = Matrix<uint64_t>(padded);
+            pb = Matrix<uint64_t>(padded);
+            pc = Matrix<uint64_t>(padded);
+            for(uint64_t i = 0; i < padded; i++) {
+                std::fill(pa.row(i), pa.row(i) + padded, 0);
+                std::fill(pb.row(i), pb.row(i) + padded, 0);
+                if(i < n) {
+                    std::copy(m1.row(i), m1.row(i) + n, pa.row(i));
+                    std::copy(m2.row(i), m2.row(i) + n, pb.row(i));
+                }
+            }
+            a = {pa.data(), pa.stride()};
+            b = {pb.data(), pb.stride()};
+            c = {pc.data(), pc.stride()};
+        }
+
+        Matrix<uint64_t> workspace(1, workspaceSize(padded, cutoff, 0));
+        uint64_t *space = workspace.data();
+
+        #pragma omp parallel default(none) shared(a, b, c, padded, cutoff, space) num_threads(numThreads)
+        {
+            #pragma omp single
+            recurse(a, b, c, padded, cutoff, 0, space);
+        }
+
+        if(padded != n) {
+            for(uint64_t i = 0; i < n; i++) {
+                std::copy(pc.row(i), pc.row(i) + n, m3.row(i));
+            }
+        }
+    }
+
+    /**
+     * Pick the cutoff that gives the fastest multiply at the given size.
+     * Each candidate is timed once on random data.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to use for parallelism.
+     * @return The fastest cutoff.
+     */
+    uint64_t tuneCutoff(const uint64_t size, int numThreads)
+    {
+        Matrix<uint64_t> v1(size), v2(size), v3(size);
+        CounterRandom::fillRows(v1, CounterRandom::streamSeed(0), 1, 10, 0, size);
+        CounterRandom::fillRows(v2, CounterRandom::streamSeed(1), 1, 10, 0, size);
+
+        uint64_t best = size;
+        auto bestTime = std::chrono::steady_clock::duration::max();
+        for(uint64_t cutoff : {64, 128, 256, 512}) {
+            if(cutoff > size) { break; }
+            auto start = std::chrono::steady_clock::now();
+            multiplyMatrix(v1, v2, v3, numThreads, cutoff);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if(elapsed < bestTime) {
+                bestTime = elapsed;
+                best = cutoff;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Run Strassen-Winograd multiplication for matrices of given size.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param cutoff: Size at which the recursion switches to the classical kernel.
+     * @return Duration taken for the multiplication operation.
+     */
+    uint64_t run(const uint64_t size, int numThreads, uint64_t cutoff) {
+        // Initialize matrices, from the same seeds as the other engines
+        Matrix<uint64_t> v1(size), v2(size), v3(size);
+        CounterRandom::fillRows(v1, CounterRandom::streamSeed(0), 1, 10, 0, size);
+        CounterRandom::fillRows(v2, CounterRandom::streamSeed(1), 1, 10, 0, size);
+
+        // Perform matrix multiplication and measure the time taken
+        PerfCounters::start();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        multiplyMatrix(v1, v2, v3, numThreads, cutoff);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
+
+        auto duration = std::chrono::duration_cast
+                        <std::chrono::microseconds>(end - start);
+
+        std::cout << "Strassen Multiplication took: " << duration.count() << " microseconds, with cutoff: " << cutoff << std::endl;
+
+        // Check the result, timed separately from the multiplication
+        Verification::verify(v1, v2, v3);
+
+        return duration.count();
+    }
+};
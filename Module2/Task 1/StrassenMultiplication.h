@@ -0,0 +1,18 @@
+#ifndef STRASSEN_MULTIPLICATION_H
+#define STRASSEN_MULTIPLICATION_H
+
+#include <iostream>
+#include <cstdint>
+
+#include "Matrix.h"
+
+namespace StrassenMultiplication
+{
+    void multiplyMatrix(const Matrix<uint64_t> &m1, const Matrix<uint64_t> &m2, Matrix<uint64_t> &m3,
+                        int numThreads, uint64_t cutoff);
+    uint64_t tuneCutoff(uint64_t size, int numThreads);
+    uint64_t run(uint64_t size, int numThreads, uint64_t cutoff);
+}
+
+
+#endif
@@ -0,0 +1,158 @@
+#include "SyrkMultiplication.h"
+#include "OMPParallelMultiplication.h"
+#include "CacheInfo.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "PerfCounters.h"
+#include "Transpose.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <omp.h>
+
+namespace SyrkMultiplication
+{
+    /**
+     * Tile t of a lower triangle of tiles, counted row by row:
+     * (0, 0), (1, 0), (1, 1), (2, 0), ...
+     */
+    void triangleTile(uint64_t t, uint64_t &bi, uint64_t &bj)
+    {
+        bi = static_cast<uint64_t>((std::sqrt(8.0 * static_cast<double>(t) + 1.0) - 1.0) / 2.0);
+        // Correct the rounding of the square root for large t.
+        while(bi * (bi + 1) / 2 > t) { bi--; }
+        while((bi + 1) * (bi + 2) / 2 <= t) { bi++; }
+        bj = t - bi * (bi + 1) / 2;
+    }
+
+    /**
+     * One triangle of m3 = m1 * m1ᵀ.
+     * @param m1: The n x k matrix A.
+     * @param m3: The n x n result. Only the chosen triangle, diagonal
+     *            included, is written unless mirror is set.
+     * @param triangle: Lower (j <= i) or upper (j >= i).
+     * @param mirror: Copy the triangle to the other half afterwards.
+     * @param numThreads: Number of threads to use for parallelism.
+     */
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, Matrix<Acc> &m3, Triangle triangle, bool mirror, int numThreads)
+    {
+        const uint64_t n = m1.rows();
+        const uint64_t inner = m1.cols();
+        // Two square panels of A and a tile of C stay in L2.
+        const uint64_t block = CacheInfo::blockSize(2, std::max(sizeof(T), sizeof(Acc)));
+        const uint64_t blocks = (n + block - 1) / block;
+        const uint64_t tiles = blocks * (blocks + 1) / 2;
+        const bool upper = triangle == Triangle::Upper;
+
+        // Off-diagonal tiles are equal work and diagonal ones half, so
+        // handing out single tiles keeps every thread busy to the end.
+        #pragma omp parallel for default(none) shared(m1, m3) firstprivate(n, inner, block, tiles, upper) num_threads(numThreads) schedule(dynamic)
+        for(uint64_t t = 0; t < tiles; t++) {
+            uint64_t bi, bj;
+            triangleTile(t, bi, bj);
+            const uint64_t i0 = bi * block, i1 = std::min(i0 + block, n);
+            const uint64_t j0 = bj * block, j1 = std::min(j0 + block, n);
+
+            // The inner dimension is blocked too, so the two panels of A
+            // are block x block and are reused from L2 across the tile.
+            for(uint64_t kk = 0; kk < inner; kk += block) {
+                const uint64_t depth = std::min(block, inner - kk);
+                for(uint64_t i = i0; i < i1; i++) {
+                    // Diagonal tiles stop at the diagonal.
+                    const uint64_t jEnd = bi == bj ? i + 1 : j1;
+                    for(uint64_t j = j0; j < jEnd; j++) {
+                        const Acc value = Transpose::dot<T, Acc>(m1.row(i) + kk, m1.row(j) + kk, depth);
+                        Acc &out = upper ? m3(j, i) : m3(i, j);
+                        out = kk == 0 ? value : out + value;
+                    }
+                }
+            }
+        }
+
+        if(mirror) { mirrorTriangle(m3, triangle, numThreads); }
+    }
+
+    /**
+     * Copy one triangle of a square matrix onto the other.
+     * @param matrix: The matrix, with the given triangle filled in.
+     * @param triangle: The triangle to copy from.
+     * @param numThreads: Number of threads to use for parallelism.
+     */
+    template <typename Acc>
+    void mirrorTriangle(Matrix<Acc> &matrix, Triangle triangle, int numThreads)
+    {
+        const uint64_t n = matrix.rows();
+        const uint64_t block = Transpose::blockSize;
+        const uint64_t blocks = (n + block - 1) / block;
+        const uint64_t tiles = blocks * (blocks + 1) / 2;
+        const bool upper = triangle == Triangle::Upper;
+
+        // Square blocks, like Transpose, so reads and writes both stay in cache.
+        #pragma omp parallel for default(none) shared(matrix) firstprivate(n, block, tiles, upper) num_threads(numThreads) schedule(dynamic, 16)
+        for(uint64_t t = 0; t < tiles; t++) {
+            uint64_t bi, bj;
+            triangleTile(t, bi, bj);
+            const uint64_t i1 = std::min((bi + 1) * block, n), j1 = std::min((bj + 1) * block, n);
+            for(uint64_t i = bi * block; i < i1; i++) {
+                const uint64_t jEnd = bi == bj ? i : j1;
+                for(uint64_t j = bj * block; j < jEnd; j++) {
+                    if(upper) { matrix(i, j) = matrix(j, i); } else { matrix(j, i) = matrix(i, j); }
+                }
+            }
+        }
+    }
+
+    /**
+     * Run A * Aᵀ for a random square A.
+     * @param size: The size of the matrices (assumed to be square).
+     * @param numThreads: Number of threads to use for parallelism.
+     * @param triangle: Triangle to compute.
+     * @param mirror: Mirror it to a full matrix inside the timed region.
+     * @return Duration taken for the multiplication operation.
+     */
+    template <typename T, typename Acc>
+    uint64_t run(const uint64_t size, int numThreads, Triangle triangle, bool mirror)
+    {
+        // Initialize matrices
+        Matrix<T> v1(size);
+        Matrix<Acc> v3(size);
+
+        // Fill matrices with random values
+        OMPParallelMultiplication::randomMatrix(v1, CounterRandom::streamSeed(0), 1, 10, numThreads);
+
+        // Perform matrix multiplication and measure the time taken
+        PerfCounters::start();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        multiplyMatrix(v1, v3, triangle, mirror, numThreads);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfCounters::stop();
+
+        auto duration = std::chrono::duration_cast
+                        <std::chrono::microseconds>(end - start);
+
+        std::cout << (triangle == Triangle::Upper ? "SYRK Upper" : "SYRK Lower") << (mirror ? " Mirrored" : "")
+                  << " Multiplication took: " << duration.count() << " microseconds" << std::endl;
+
+        // Check the result against v1 * v1ᵀ, timed separately from the
+        // multiplication. An unmirrored result is mirrored first.
+        if(!mirror) { mirrorTriangle(v3, triangle, numThreads); }
+        Matrix<T> v1t(size);
+        OMPParallelMultiplication::transposeMatrix(v1, v1t, numThreads);
+        Verification::verify(v1, v1t, v3);
+
+        return duration.count();
+    }
+
+    // Every accumulator type is also a storage type, so mirrorTriangle covers results too.
+#define INSTANTIATE(name, T, Acc) \
+    template void multiplyMatrix<T, Acc>(const Matrix<T> &, Matrix<Acc> &, Triangle, bool, int); \
+    template void mirrorTriangle<T>(Matrix<T> &, Triangle, int); \
+    template uint64_t run<T, Acc>(uint64_t, int, Triangle, bool);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
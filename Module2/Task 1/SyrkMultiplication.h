@@ -0,0 +1,33 @@
+#ifndef SYRK_MULTIPLICATION_H
+#define SYRK_MULTIPLICATION_H
+
+#include <iostream>
+#include <cstdint>
+
+#include "Matrix.h"
+
+/**
+ * Symmetric rank-k product, C = A * Aᵀ.
+ *
+ * C is symmetric, so only one triangle is computed, about half the work of
+ * a full product. Element (i, j) is the dot product of rows i and j of A,
+ * both unit stride, so no transpose is needed. The triangle is cut into
+ * square tiles and the tiles, not row bands, are shared between threads:
+ * a band of rows near the bottom of a lower triangle holds far more
+ * elements than one near the top, but every off-diagonal tile is the same
+ * work.
+ */
+namespace SyrkMultiplication
+{
+    enum class Triangle { Lower, Upper };
+
+    template <typename T, typename Acc>
+    void multiplyMatrix(const Matrix<T> &m1, Matrix<Acc> &m3, Triangle triangle, bool mirror, int numThreads);
+    template <typename Acc>
+    void mirrorTriangle(Matrix<Acc> &matrix, Triangle triangle, int numThreads);
+    template <typename T = uint64_t, typename Acc = T>
+    uint64_t run(uint64_t size, int numThreads, Triangle triangle, bool mirror);
+}
+
+
+#endif
@@ -0,0 +1,102 @@
+#include "ThreadPool.h"
+#include "Affinity.h"
+
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * Start the worker threads.
+ * @param numThreads: Total threads in the pool, including the caller of run().
+ * @param pin: Bind thread i to the CPU the affinity policy gives it.
+ */
+ThreadPool::ThreadPool(int numThreads, bool pin)
+    : numThreads(numThreads < 1 ? 1 : numThreads), pin(pin)
+{
+    for(int i = 1; i < this->numThreads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        if(pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(Affinity::cpuFor(i), &set);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCv.notify_all();
+    for(auto& t : workers) { t.join(); }
+}
+
+/**
+ * Run task(threadIndex) on every thread of the pool and wait for all of them.
+ * @param task: Work to run, given the index of the thread running it.
+ */
+void ThreadPool::run(const std::function<void(int)> &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        pending = static_cast<int>(workers.size());
+        generation++;
+    }
+    startCv.notify_all();
+
+    {
+        std::unique_ptr<Affinity::ScopedPin> callerPin;
+        if(pin) { callerPin = std::make_unique<Affinity::ScopedPin>(Affinity::cpuFor(0)); }
+        task(0);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [this] { return pending == 0; });
+    this->task = nullptr;
+}
+
+/**
+ * Split [begin, end) into one contiguous band per thread and run body on each.
+ * The last thread takes any remainder.
+ * @param begin: First index (inclusive).
+ * @param end: Last index (exclusive).
+ * @param body: Called with the band start (inclusive) and end (exclusive).
+ */
+void ThreadPool::parallelFor(uint64_t begin, uint64_t end,
+                             const std::function<void(uint64_t, uint64_t)> &body)
+{
+    const uint64_t perThread = (end - begin) / numThreads;
+    run([&](int th) {
+        uint64_t start = begin + th * perThread;
+        uint64_t stop = (th == numThreads - 1) ? end : start + perThread;
+        if(start < stop) { body(start, stop); }
+    });
+}
+
+/**
+ * Wait for a new generation of work, run it, and report back.
+ * @param index: Index of this worker within the pool.
+ */
+void ThreadPool::workerLoop(int index)
+{
+    uint64_t seen = 0;
+    while(true) {
+        const std::function<void(int)> *current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCv.wait(lock, [&] { return stopping || generation != seen; });
+            if(stopping) { return; }
+            seen = generation;
+            current = task;
+        }
+
+        (*current)(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--pending == 0) { doneCv.notify_one(); }
+    }
+}
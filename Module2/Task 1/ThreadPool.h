@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that are created once and reused.
+ *
+ * run() hands the same task to every thread and blocks until all of them
+ * have finished it, so each call acts as a fork followed by a barrier.
+ * The calling thread takes part as thread 0, so a pool of size n starts
+ * n - 1 workers.
+ *
+ * A pinned pool binds thread i to Affinity::cpuFor(i). The caller is only
+ * bound for the duration of each run(), so code outside the pool keeps
+ * its original mask.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int numThreads, bool pin = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return numThreads; }
+    bool pinned() const { return pin; }
+
+    void run(const std::function<void(int)> &task);
+    void parallelFor(uint64_t begin, uint64_t end,
+                     const std::function<void(uint64_t, uint64_t)> &body);
+
+private:
+    void workerLoop(int index);
+
+    int numThreads;
+    bool pin;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+    const std::function<void(int)> *task = nullptr;
+    uint64_t generation = 0;
+    int pending = 0;
+    bool stopping = false;
+};
+
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "Matrix.h"
+
+/**
+ * Transposed-B operand layout.
+ *
+ * The row-major kernels read B one column at a time, a stride of a whole
+ * row between consecutive loads. Storing Bᵀ instead turns every output
+ * element into a dot product of two unit-stride rows. Callers that
+ * multiply by the same B repeatedly can transpose it once and pass Bᵀ to
+ * the engines' multiplyMatrixTransposed directly.
+ */
+namespace Transpose
+{
+    // Edge of the square blocks the transpose is done in. 32 x 32 of the
+    // widest type is 8KB per block, both blocks stay in L1.
+    constexpr uint64_t blockSize = 32;
+
+    /**
+     * Write rows [startRow, endRow) of dst = srcᵀ. Each engine splits the
+     * rows of dst between its threads, so no two threads write the same row.
+     * @param src: Matrix to transpose.
+     * @param dst: Matrix of src.cols() x src.rows() receiving the transpose.
+     * @param startRow: First row of dst (inclusive).
+     * @param endRow: Last row of dst (exclusive).
+     */
+    template <typename T>
+    void transposeRows(const Matrix<T> &src, Matrix<T> &dst, uint64_t startRow, uint64_t endRow)
+    {
+        const uint64_t cols = dst.cols();
+        for(uint64_t ii = startRow; ii < endRow; ii += blockSize) {
+            const uint64_t iEnd = std::min(ii + blockSize, endRow);
+            for(uint64_t jj = 0; jj < cols; jj += blockSize) {
+                const uint64_t jEnd = std::min(jj + blockSize, cols);
+                for(uint64_t i = ii; i < iEnd; i++) {
+                    T *out = dst.row(i);
+                    for(uint64_t j = jj; j < jEnd; j++) { out[j] = src(j, i); }
+                }
+            }
+        }
+    }
+
+    /**
+     * Dot product of two unit-stride rows, summed in Acc. Four partial sums
+     * break the dependency on a single accumulator.
+     */
+    template <typename T, typename Acc>
+    Acc dot(const T *a, const T *b, uint64_t n)
+    {
+        Acc s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        uint64_t k = 0;
+        for(; k + 4 <= n; k += 4) {
+            s0 += static_cast<Acc>(a[k]) * static_cast<Acc>(b[k]);
+            s1 += static_cast<Acc>(a[k + 1]) * static_cast<Acc>(b[k + 1]);
+            s2 += static_cast<Acc>(a[k + 2]) * static_cast<Acc>(b[k + 2]);
+            s3 += static_cast<Acc>(a[k + 3]) * static_cast<Acc>(b[k + 3]);
+        }
+        for(; k < n; k++) { s0 += static_cast<Acc>(a[k]) * static_cast<Acc>(b[k]); }
+        return (s0 + s1) + (s2 + s3);
+    }
+}
+
+
+#endif
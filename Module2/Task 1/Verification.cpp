@@ -0,0 +1,252 @@
+#include "Verification.h"
+#include "ElementTypes.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+
+namespace Verification
+{
+    Mode currentMode = Mode::Freivalds;
+    int currentRounds = 20;
+    uint64_t lastDuration = 0;
+
+    /**
+     * Select the verification used by every engine's run().
+     * @param mode: Freivalds or Exact.
+     * @param rounds: Freivalds rounds, each halves the chance of missing a wrong result.
+     */
+    void setMode(Mode mode, int rounds)
+    {
+        currentMode = mode;
+        currentRounds = rounds < 1 ? 1 : rounds;
+    }
+
+    Mode mode() { return currentMode; }
+
+    /**
+     * Time, in microseconds, taken by the most recent call to verify().
+     */
+    uint64_t lastMicroseconds() { return lastDuration; }
+
+    /**
+     * Report a run's verification time, for runs that check several
+     * results: the sum of what their verify() calls returned.
+     */
+    void setLastMicroseconds(uint64_t microseconds) { lastDuration = microseconds; }
+
+    /**
+     * Integers are checked modulo 2^64, which never overflows and is still
+     * exact for any product that fits the accumulator. Floating point is
+     * checked in double.
+     */
+    template <typename T>
+    using Wide = std::conditional_t<std::is_floating_point_v<T>, double, uint64_t>;
+
+    template <typename W>
+    bool equal(W expected, W actual)
+    {
+        if constexpr(std::is_floating_point_v<W>) {
+            return std::fabs(expected - actual) <= 1e-9 * std::max(1.0, std::fabs(expected));
+        } else {
+            return expected == actual;
+        }
+    }
+
+    void fail(uint64_t row, uint64_t col)
+    {
+        std::cout << "Error, value is not correct at: [" << row << ", " << col << "]" << std::endl;
+
+        // Throw exception and stop program running if there's
+        // any calculation is not correct.
+        throw std::runtime_error("Result is incorrect.");
+    }
+
+    /**
+     * Freivalds' check: for a random 0/1 vector r, m1 * (m2 * r) must equal m3 * r.
+     * A wrong m3 passes one round with probability at most 1/2.
+     */
+    template <typename T, typename Acc>
+    void freivalds(const Matrix<T> &m1, const Matrix<T> &m2, const Matrix<Acc> &m3, int rounds)
+    {
+        using W = Wide<Acc>;
+        const uint64_t n = m3.rows();
+        const uint64_t inner = m1.cols();
+        const uint64_t cols = m3.cols();
+
+        std::random_device rd;
+        std::mt19937_64 rng(rd());
+        std::vector<W> r(cols), br(inner), abr(n), cr(n);
+
+        for(int round = 0; round < rounds; round++) {
+            for(auto &value : r) { value = static_cast<W>(rng() & 1); }
+
+            #pragma omp parallel for default(none) shared(m2, r, br) firstprivate(inner, cols)
+            for(uint64_t i = 0; i < inner; i++) {
+                const T *b = m2.row(i);
+                W sum = 0;
+                for(uint64_t j = 0; j < cols; j++) { sum += static_cast<W>(b[j]) * r[j]; }
+                br[i] = sum;
+            }
+
+            uint64_t badRow = std::numeric_limits<uint64_t>::max();
+            #pragma omp parallel for default(none) shared(m1, m3, r, br) firstprivate(n, inner, cols) \
+                reduction(min: badRow)
+            for(uint64_t i = 0; i < n; i++) {
+                const T *a = m1.row(i);
+                const Acc *c = m3.row(i);
+                W left = 0, right = 0;
+                for(uint64_t k = 0; k < inner; k++) { left += static_cast<W>(a[k]) * br[k]; }
+                for(uint64_t j = 0; j < cols; j++) { right += static_cast<W>(c[j]) * r[j]; }
+                if(!equal(left, right) && i < badRow) { badRow = i; }
+            }
+
+            if(badRow != std::numeric_limits<uint64_t>::max()) {
+                // Freivalds only narrows it to a row, find the column for the report.
+                for(uint64_t j = 0; j < cols; j++) {
+                    W result = 0;
+                    for(uint64_t k = 0; k < inner; k++) {
+                        result += static_cast<W>(m1(badRow, k)) * static_cast<W>(m2(k, j));
+                    }
+                    if(!equal(result, static_cast<W>(m3(badRow, j)))) { fail(badRow, j); }
+                }
+                fail(badRow, 0);
+            }
+        }
+    }
+
+    /**
+     * Recompute every element of the product and compare.
+     */
+    template <typename T, typename Acc>
+    void exact(const Matrix<T> &m1, const Matrix<T> &m2, const Matrix<Acc> &m3)
+    {
+        using W = Wide<Acc>;
+        const uint64_t n = m3.rows();
+        const uint64_t inner = m1.cols();
+        const uint64_t cols = m3.cols();
+
+        uint64_t badIndex = std::numeric_limits<uint64_t>::max();
+        #pragma omp parallel for default(none) shared(m1, m2, m3) firstprivate(n, inner, cols) \
+            reduction(min: badIndex)
+        for(uint64_t i = 0; i < n; i++) {
+            for(uint64_t j = 0; j < cols; j++) {
+                W result = 0;
+                for(uint64_t k = 0; k < inner; k++) {
+                    result += static_cast<W>(m1(i, k)) * static_cast<W>(m2(k, j));
+                }
+                if(!equal(result, static_cast<W>(m3(i, j))) && i * cols + j < badIndex) {
+                    badIndex = i * cols + j;
+                }
+            }
+        }
+
+        if(badIndex != std::numeric_limits<uint64_t>::max()) {
+            fail(badIndex / cols, badIndex % cols);
+        }
+    }
+
+    /**
+     * Check that m3 = m1 * m2 using the selected mode, in parallel.
+     * Throws std::runtime_error if the result is wrong.
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: The product to check.
+     * @return Duration of the check, in microseconds.
+     */
+    template <typename T, typename Acc>
+    uint64_t verify(const Matrix<T> &m1, const Matrix<T> &m2, const Matrix<Acc> &m3)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if(currentMode == Mode::Exact) {
+            exact(m1, m2, m3);
+        } else {
+            freivalds(m1, m2, m3, currentRounds);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        lastDuration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        return lastDuration;
+    }
+
+    /**
+     * Check that product = chain[0] * chain[1] * ... with Freivalds' check,
+     * multiplying the random vector through the chain from the right, in
+     * either mode: recomputing a chain exactly costs as much as the chain.
+     * Throws std::runtime_error if the result is wrong.
+     * @param chain: The matrices of the chain, in order.
+     * @param product: The product to check.
+     * @return Duration of the check, in microseconds.
+     */
+    template <typename T>
+    uint64_t verifyChain(const std::vector<const Matrix<T>*> &chain, const Matrix<T> &product)
+    {
+        using W = Wide<T>;
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::random_device rd;
+        std::mt19937_64 rng(rd());
+        const uint64_t rows = product.rows(), cols = product.cols();
+
+        // x = m * x for one matrix of the chain
+        auto apply = [](const Matrix<T> &m, const std::vector<W> &x) {
+            std::vector<W> y(m.rows());
+            const uint64_t mRows = m.rows(), mCols = m.cols();
+            #pragma omp parallel for default(none) shared(m, x, y) firstprivate(mRows, mCols)
+            for(uint64_t i = 0; i < mRows; i++) {
+                const T *a = m.row(i);
+                W sum = 0;
+                for(uint64_t k = 0; k < mCols; k++) { sum += static_cast<W>(a[k]) * x[k]; }
+                y[i] = sum;
+            }
+            return y;
+        };
+
+        for(int round = 0; round < currentRounds; round++) {
+            std::vector<W> r(cols);
+            for(auto &value : r) { value = static_cast<W>(rng() & 1); }
+
+            std::vector<W> left = r;
+            for(auto m = chain.rbegin(); m != chain.rend(); ++m) { left = apply(**m, left); }
+            const std::vector<W> right = apply(product, r);
+
+            for(uint64_t i = 0; i < rows; i++) {
+                if(equal(left[i], right[i])) { continue; }
+
+                // Find the column for the report: row i of the chain is
+                // row i of the first matrix times the rest.
+                std::vector<W> row(chain.front()->row(i), chain.front()->row(i) + chain.front()->cols());
+                for(uint64_t m = 1; m < chain.size(); m++) {
+                    std::vector<W> next(chain[m]->cols(), 0);
+                    for(uint64_t k = 0; k < row.size(); k++) {
+                        const T *b = chain[m]->row(k);
+                        for(uint64_t j = 0; j < next.size(); j++) { next[j] += row[k] * static_cast<W>(b[j]); }
+                    }
+                    row = std::move(next);
+                }
+                for(uint64_t j = 0; j < cols; j++) {
+                    if(!equal(row[j], static_cast<W>(product(i, j)))) { fail(i, j); }
+                }
+                fail(i, 0);
+            }
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        lastDuration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        return lastDuration;
+    }
+
+    // Every accumulator type is also a storage type, so verifyChain covers chains of results too.
+#define INSTANTIATE(name, T, Acc) \
+    template uint64_t verify<T, Acc>(const Matrix<T> &, const Matrix<T> &, const Matrix<Acc> &); \
+    template uint64_t verifyChain<T>(const std::vector<const Matrix<T>*> &, const Matrix<T> &);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
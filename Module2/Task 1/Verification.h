@@ -0,0 +1,30 @@
+#ifndef VERIFICATION_H
+#define VERIFICATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.h"
+
+namespace Verification
+{
+    /**
+     * How run() checks m3 == m1 * m2.
+     * Freivalds: k rounds of the randomised O(n^2) check (default).
+     * Exact: recompute every element, O(n^3).
+     */
+    enum class Mode { Freivalds, Exact };
+
+    void setMode(Mode mode, int rounds = 20);
+    Mode mode();
+    uint64_t lastMicroseconds();
+    void setLastMicroseconds(uint64_t microseconds);
+
+    template <typename T, typename Acc>
+    uint64_t verify(const Matrix<T> &m1, const Matrix<T> &m2, const Matrix<Acc> &m3);
+    template <typename T>
+    uint64_t verifyChain(const std::vector<const Matrix<T>*> &chain, const Matrix<T> &product);
+}
+
+
+#endif
@@ -0,0 +1,192 @@
+#include "WorkStealing.h"
+#include "ElementTypes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace WorkStealing
+{
+    Deque::Deque(uint64_t capacity)
+        : capacity(capacity == 0 ? 1 : capacity),
+          buffer(new std::atomic<uint32_t>[capacity == 0 ? 1 : capacity])
+    {
+    }
+
+    /**
+     * Push an item on the bottom of the deque. Owner thread only.
+     * @return False if the deque is full.
+     */
+    bool Deque::push(uint32_t item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if(b - t >= static_cast<int64_t>(capacity)) { return false; }
+        buffer[b % capacity].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Pop an item from the bottom of the deque. Owner thread only.
+     * @return False if the deque was empty, or a thief won the last item.
+     */
+    bool Deque::pop(uint32_t &item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if(t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = buffer[b % capacity].load(std::memory_order_relaxed);
+        if(t == b) {
+            // Last item, race any thieves for it.
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    /**
+     * Steal an item from the top of the deque. Any thread.
+     * @return False if the deque was empty or another thread got there first.
+     */
+    bool Deque::steal(uint32_t &item)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b) { return false; }
+
+        item = buffer[t % capacity].load(std::memory_order_relaxed);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+    }
+
+    /**
+     * Compute one tile of the output, rows [rowStart, rowEnd) and columns
+     * [colStart, colEnd), with an i-k-j loop so B and C are read along rows.
+     */
+    template <typename T, typename Acc>
+    void multiplyTile(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                      uint64_t rowStart, uint64_t rowEnd, uint64_t colStart, uint64_t colEnd)
+    {
+        const uint64_t inner = m1.cols();
+        for(uint64_t i = rowStart; i < rowEnd; i++) {
+            const T *a = m1.row(i);
+            Acc *c = m3.row(i);
+            std::fill(c + colStart, c + colEnd, 0);
+            for(uint64_t k = 0; k < inner; k++) {
+                const Acc aik = a[k];
+                const T *b = m2.row(k);
+                for(uint64_t j = colStart; j < colEnd; j++) {
+                    c[j] += aik * static_cast<Acc>(b[j]);
+                }
+            }
+        }
+    }
+
+    /**
+     * Multiply two matrices by splitting the output into square tiles that
+     * the pool's threads schedule between themselves by work stealing.
+     *
+     * Tiles are numbered column of tiles first, so consecutive tiles share
+     * the same panel of B. Each thread is seeded with a contiguous run of
+     * that order and works through it from the front; thieves take from the
+     * back, starting with the thread whose run ends just before their own.
+     *
+     * @param m1: First matrix.
+     * @param m2: Second matrix.
+     * @param m3: Matrix to store the result.
+     * @param pool: Threads to run on.
+     * @param tileSize: Edge length of an output tile, in elements.
+     * @return Total steals and idle time across all threads.
+     */
+    template <typename T, typename Acc>
+    Stats multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                         ThreadPool &pool, uint64_t tileSize)
+    {
+        const int numThreads = pool.size();
+        const uint64_t tileRows = (m3.rows() + tileSize - 1) / tileSize;
+        const uint64_t tileCols = (m3.cols() + tileSize - 1) / tileSize;
+        const uint64_t numTiles = tileRows * tileCols;
+        const uint64_t perThread = numTiles / numThreads;
+
+        std::vector<std::unique_ptr<Deque>> deques;
+        for(int th = 0; th < numThreads; th++) {
+            uint64_t first = th * perThread;
+            uint64_t last = (th == numThreads - 1) ? numTiles : first + perThread;
+            deques.push_back(std::make_unique<Deque>(last - first));
+            // Push in reverse so the owner pops its run from the front.
+            for(uint64_t tile = last; tile > first; tile--) {
+                deques.back()->push(static_cast<uint32_t>(tile - 1));
+            }
+        }
+
+        std::atomic<uint64_t> remaining{numTiles};
+        std::vector<Stats> threadStats(numThreads);
+
+        pool.run([&](int th) {
+            using clock = std::chrono::steady_clock;
+            auto begin = clock::now();
+            clock::duration busy{0};
+            uint64_t steals = 0;
+
+            auto execute = [&](uint32_t tile) {
+                auto start = clock::now();
+                uint64_t tileRow = tile % tileRows;
+                uint64_t tileCol = tile / tileRows;
+                uint64_t rowStart = tileRow * tileSize;
+                uint64_t colStart = tileCol * tileSize;
+                multiplyTile(m1, m2, m3, rowStart, std::min(rowStart + tileSize, m3.rows()),
+                             colStart, std::min(colStart + tileSize, m3.cols()));
+                remaining.fetch_sub(1, std::memory_order_relaxed);
+                busy += clock::now() - start;
+            };
+
+            uint32_t tile;
+            while(deques[th]->pop(tile)) { execute(tile); }
+
+            // Own run is finished, help the others until every tile is done.
+            while(remaining.load(std::memory_order_relaxed) != 0) {
+                bool stole = false;
+                for(int offset = 1; offset < numThreads && !stole; offset++) {
+                    int victim = (th - offset + numThreads) % numThreads;
+                    if(deques[victim]->steal(tile)) {
+                        steals++;
+                        stole = true;
+                        execute(tile);
+                    }
+                }
+                if(!stole) { std::this_thread::yield(); }
+            }
+
+            auto idle = (clock::now() - begin) - busy;
+            threadStats[th].steals = steals;
+            threadStats[th].idleMicroseconds =
+                std::chrono::duration_cast<std::chrono::microseconds>(idle).count();
+        });
+
+        Stats total;
+        for(const auto &stats : threadStats) {
+            total.steals += stats.steals;
+            total.idleMicroseconds += stats.idleMicroseconds;
+        }
+        return total;
+    }
+
+#define INSTANTIATE(name, T, Acc) \
+    template Stats multiplyMatrix<T, Acc>(const Matrix<T> &, const Matrix<T> &, Matrix<Acc> &, \
+                                          ThreadPool &, uint64_t);
+    FOR_EACH_ELEMENT_TYPE(INSTANTIATE)
+#undef INSTANTIATE
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+namespace WorkStealing
+{
+    /**
+     * Chase-Lev work-stealing deque with a fixed capacity.
+     * The owning thread pushes and pops at the bottom, any other thread
+     * may steal from the top.
+     */
+    class Deque
+    {
+    public:
+        explicit Deque(uint64_t capacity);
+
+        bool push(uint32_t item);
+        bool pop(uint32_t &item);
+        bool steal(uint32_t &item);
+
+    private:
+        uint64_t capacity;
+        std::unique_ptr<std::atomic<uint32_t>[]> buffer;
+        // Keep the thief-side and owner-side indices on separate cache lines.
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+    };
+
+    /**
+     * Scheduler statistics from one multiplication, summed over all threads.
+     */
+    struct Stats
+    {
+        uint64_t steals = 0;
+        uint64_t idleMicroseconds = 0;
+    };
+
+    template <typename T, typename Acc>
+    Stats multiplyMatrix(const Matrix<T> &m1, const Matrix<T> &m2, Matrix<Acc> &m3,
+                         ThreadPool &pool, uint64_t tileSize);
+}
+
+
+#endif
@@ -1,2 +1,2 @@
-g++ -fopenmp main.cpp OMPParallelMultiplication.cpp ParallelMultiplication.cpp SequentialMultiplication.cpp -o MatrixMulti.exe
+g++ -O2 -fopenmp main.cpp OMPParallelMultiplication.cpp ParallelMultiplication.cpp SequentialMultiplication.cpp CacheInfo.cpp PackedMultiplication.cpp ThreadPool.cpp WorkStealing.cpp StrassenMultiplication.cpp Verification.cpp CounterRandom.cpp Affinity.cpp Benchmark.cpp PerfCounters.cpp Autotuner.cpp Gemm.cpp SparseMultiplication.cpp MatrixFile.cpp OutOfCoreMultiplication.cpp ChainMultiplication.cpp SyrkMultiplication.cpp -o MatrixMulti.exe
 
@@ -1,37 +1,128 @@
 #include "SequentialMultiplication.h"
 #include "ParallelMultiplication.h"
 #include "OMPParallelMultiplication.h"
+#include "StrassenMultiplication.h"
+#include "CacheInfo.h"
+#include "ElementTypes.h"
+#include "Verification.h"
+#include "CounterRandom.h"
+#include "Affinity.h"
+#include "Benchmark.h"
+#include "PerfCounters.h"
+#include "Autotuner.h"
+#include "Gemm.h"
+#include "SparseMultiplication.h"
+#include "OutOfCoreMultiplication.h"
+#include "ChainMultiplication.h"
+#include "SyrkMultiplication.h"
 
 #include <iostream>
 #include <random>
 #include <fstream>
 #include <thread>
+#include <map>
+#include <sstream>
+#include <functional>
+#include <tuple>
+#include <algorithm>
 
 /**
  * Structure to hold the results of matrix multiplication tests.
+ * One entry per configuration, summarising all of its repetitions.
  */
 struct testResults
 {
     std::string type;
+    std::string dtype;
+    std::string schedule;
     uint64_t numThreads{};
     uint64_t chunkSize{};
-    uint64_t time{};
     uint64_t size{};
+    // Shape of the product, M x K times K x N, and how many of them.
+    // Square runs have m = n = k = size and a batch of 1.
+    uint64_t m{};
+    uint64_t n{};
+    uint64_t k{};
+    uint64_t batch{1};
+    // Fraction of non-zeros in each input, 1 for dense runs.
+    double densityA{1};
+    double densityB{1};
+    int warmup{};
+    Benchmark::Summary time;
+    uint64_t verifyTime{};
+    uint64_t steals{};
+    uint64_t idleTime{};
+    PerfCounters::Counts counters{};
 
 };
 
+/**
+ * GFLOP/s of a row's median time, counting the whole batch. Sparse kernels
+ * skip the zeros, so 2 * m * n * k overstates their work; their rows are
+ * left empty. Sparse_DENSE ran the dense kernel and is counted as usual.
+ */
+std::string gflopsField(const testResults& tr, const std::string &missing)
+{
+    if(tr.type.rfind("Sparse_", 0) == 0 && tr.type != "Sparse_DENSE") { return missing; }
+    std::ostringstream field;
+    field << Benchmark::gflops(tr.m * tr.batch, tr.n, tr.k, tr.time.median);
+    return field.str();
+}
+
 /**
  * Print the test results to the console.
  * @param tr: The test results to be printed.
  */
 void printTestResults(const testResults& tr)
 {
-    std::cout << tr.type << " | " << std::to_string(tr.numThreads) << " | " << std::to_string(tr.time)
-                << " | " << std::to_string(tr.size) << std::endl;
+    std::cout << tr.type << " | " << std::to_string(tr.numThreads) << " | " << tr.time.median
+                << " us (p5 " << tr.time.p5 << ", p95 " << tr.time.p95 << ", sd " << tr.time.stddev
+                << ") | " << gflopsField(tr, "-") << " GFLOP/s | "
+                << std::to_string(tr.size) << std::endl;
+}
+
+/**
+ * A counter value for the results file, empty where it was not counted.
+ */
+std::string counterField(int64_t value, const std::string &missing)
+{
+    return value < 0 ? missing : std::to_string(value);
 }
 
 /**
- * Write the test results to a CSV file.
+ * Instructions per cycle, empty where either counter is missing.
+ */
+std::string ipcField(const PerfCounters::Counts &counts, const std::string &missing)
+{
+    const int64_t cycles = counts[PerfCounters::Cycles], instructions = counts[PerfCounters::Instructions];
+    if(cycles <= 0 || instructions < 0) { return missing; }
+    return std::to_string(static_cast<double>(instructions) / static_cast<double>(cycles));
+}
+
+/**
+ * Speedup of every row relative to the sequential multiplication at the
+ * same size, or 0 if the sequential engine was not run at that size or
+ * the row is not a single square product.
+ */
+std::vector<double> speedups(const std::vector<testResults>& data)
+{
+    std::map<uint64_t, double> sequentialTime;
+    for (const auto& row : data) {
+        if (row.type == "Sequential") { sequentialTime[row.size] = row.time.median; }
+    }
+
+    std::vector<double> result;
+    for (const auto& row : data) {
+        const bool square = row.m == row.size && row.n == row.size && row.k == row.size && row.batch == 1;
+        auto seq = sequentialTime.find(row.size);
+        result.push_back(square && seq != sequentialTime.end() && row.time.median != 0 ? seq->second / row.time.median : 0);
+    }
+    return result;
+}
+
+/**
+ * Write the test results to a CSV file, one row per configuration.
+ * Times are in microseconds, the column names carry their units.
  * @param filename: Name of the CSV file to write to.
  * @param data: Vector containing the test results.
  */
@@ -44,114 +135,697 @@ void writeCSV(const std::string& filename, const std::vector<testResults>& data)
         std::cerr << "Failed to open the CSV file for writing." << std::endl;
         return;
     }
+
     // Write headers to the CSV file
+    csvFile << "type,dtype,size,m,n,k,batch,density_a,density_b,numThreads,schedule,chunksize,warmup,reps,"
+            << "median_us,p5_us,p95_us,mean_us,stddev_us,min_us,max_us,gflops,"
+            << "verify_us,steals,idle_us,speedup,seed,ipc";
+    for (int event = 0; event < PerfCounters::NumEvents; event++) {
+        csvFile << "," << PerfCounters::name(static_cast<PerfCounters::Event>(event));
+    }
+    csvFile << std::endl;
 
-    csvFile << "type,numThreads,chunksize,time,size" << std::endl;
     // Write the data to the CSV file
-    for (const auto& row : data) {
+    const std::vector<double> speedup = speedups(data);
+    for (size_t i = 0; i < data.size(); i++) {
+        const testResults& row = data[i];
         csvFile << row.type << ","
+                << row.dtype << ","
+                << row.size << ","
+                << row.m << ","
+                << row.n << ","
+                << row.k << ","
+                << row.batch << ","
+                << row.densityA << ","
+                << row.densityB << ","
                 << row.numThreads << ","
+                << row.schedule << ","
                 << row.chunkSize << ","
-                << row.time << ","
-                << row.size << std::endl;
+                << row.warmup << ","
+                << row.time.samples << ","
+                << row.time.median << ","
+                << row.time.p5 << ","
+                << row.time.p95 << ","
+                << row.time.mean << ","
+                << row.time.stddev << ","
+                << row.time.min << ","
+                << row.time.max << ","
+                << gflopsField(row, "") << ","
+                << row.verifyTime << ","
+                << row.steals << ","
+                << row.idleTime << ","
+                << speedup[i] << ","
+                << CounterRandom::seed() << ","
+                << ipcField(row.counters, "");
+        for (int64_t count : row.counters) { csvFile << "," << counterField(count, ""); }
+        csvFile << std::endl;
     }
 
     // Close the CSV file
     csvFile.close();
 }
 
-int main() {
+/**
+ * Write the test results as JSON lines, one object per configuration,
+ * with the same fields as the CSV.
+ * @param filename: Name of the file to write to.
+ * @param data: Vector containing the test results.
+ */
+void writeJSON(const std::string& filename, const std::vector<testResults>& data) {
+    std::ofstream jsonFile(filename);
+    if (!jsonFile.is_open()) {
+        std::cerr << "Failed to open the JSON file for writing." << std::endl;
+        return;
+    }
+
+    const std::vector<double> speedup = speedups(data);
+    for (size_t i = 0; i < data.size(); i++) {
+        const testResults& row = data[i];
+        jsonFile << "{\"type\": \"" << row.type << "\""
+                 << ", \"dtype\": \"" << row.dtype << "\""
+                 << ", \"size\": " << row.size
+                 << ", \"m\": " << row.m
+                 << ", \"n\": " << row.n
+                 << ", \"k\": " << row.k
+                 << ", \"batch\": " << row.batch
+                 << ", \"density_a\": " << row.densityA
+                 << ", \"density_b\": " << row.densityB
+                 << ", \"numThreads\": " << row.numThreads
+                 << ", \"schedule\": \"" << row.schedule << "\""
+                 << ", \"chunksize\": " << row.chunkSize
+                 << ", \"warmup\": " << row.warmup
+                 << ", \"reps\": " << row.time.samples
+                 << ", \"median_us\": " << row.time.median
+                 << ", \"p5_us\": " << row.time.p5
+                 << ", \"p95_us\": " << row.time.p95
+                 << ", \"mean_us\": " << row.time.mean
+                 << ", \"stddev_us\": " << row.time.stddev
+                 << ", \"min_us\": " << row.time.min
+                 << ", \"max_us\": " << row.time.max
+                 << ", \"gflops\": " << gflopsField(row, "null")
+                 << ", \"verify_us\": " << row.verifyTime
+                 << ", \"steals\": " << row.steals
+                 << ", \"idle_us\": " << row.idleTime
+                 << ", \"speedup\": " << speedup[i]
+                 << ", \"seed\": " << CounterRandom::seed()
+                 << ", \"ipc\": " << ipcField(row.counters, "null");
+        for (int event = 0; event < PerfCounters::NumEvents; event++) {
+            jsonFile << ", \"" << PerfCounters::name(static_cast<PerfCounters::Event>(event)) << "\": "
+                     << counterField(row.counters[event], "null");
+        }
+        jsonFile << "}" << std::endl;
+    }
+}
+
+/**
+ * Entry points of the engines for one element type.
+ */
+struct dtypeEngines
+{
+    uint64_t (*sequential)(uint64_t, bool);
+    uint64_t (*parallel)(uint64_t, int, ParallelMultiplication::TileMode, bool, WorkStealing::Stats *);
+    uint64_t (*omp)(uint64_t, int, int, int, OMPParallelMultiplication::Kernel);
+    Autotuner::Setting (*tune)(uint64_t, int, int);
+    uint64_t (*gemm)(uint64_t, uint64_t, uint64_t, uint64_t, int, Gemm::Backend);
+    uint64_t (*sparse)(uint64_t, int, double, double);
+    uint64_t (*outOfCore)(uint64_t, int, uint64_t, const std::string &);
+    uint64_t (*multiplyFiles)(const std::string &, const std::string &, const std::string &, int);
+    uint64_t (*chain)(const std::vector<uint64_t> &, int);
+    uint64_t (*syrk)(uint64_t, int, SyrkMultiplication::Triangle, bool);
+};
+
+/**
+ * Dispatch table from --dtype name to the engines instantiated for that type.
+ */
+const std::map<std::string, dtypeEngines> &dtypeTable()
+{
+#define DTYPE_ENTRY(name, T, Acc) \
+    {name, {SequentialMultiplication::run<T, Acc>, ParallelMultiplication::run<T, Acc>, \
+            OMPParallelMultiplication::run<T, Acc>, Autotuner::tune<T, Acc>, Gemm::run<T, Acc>, \
+            SparseMultiplication::run<T, Acc>, OutOfCoreMultiplication::run<T, Acc>, \
+            OutOfCoreMultiplication::multiplyFiles<T, Acc>, ChainMultiplication::run<T, Acc>, \
+            SyrkMultiplication::run<T, Acc>}},
+    static const std::map<std::string, dtypeEngines> table = {
+        FOR_EACH_ELEMENT_TYPE(DTYPE_ENTRY)
+    };
+#undef DTYPE_ENTRY
+    return table;
+}
+
+/**
+ * What to run, from the command line.
+ */
+struct options
+{
+    std::string dtype = "uint64";
+    std::vector<uint64_t> sizes = {1000};
+    std::vector<std::string> engines = {"sequential", "sequential_transposed", "parallel", "parallel_transposed",
+                                        "tiled_l1", "tiled_l2", "tiled_l3", "stealing", "strassen",
+                                        "omp", "omp_transposed", "omp_packed", "omp_recursive", "gemm_threads", "gemm_omp", "sparse",
+                                        "out_of_core", "chain", "syrk_lower", "syrk_upper"};
+    std::vector<uint64_t> threads;
+    std::vector<std::string> schedules = {"auto", "static", "dynamic", "guided", "tuned"};
+    std::vector<uint64_t> chunks;
+    std::vector<uint64_t> shape;
+    uint64_t batch = 1;
+    std::vector<std::pair<double, double>> densities = {{0.01, 0.01}, {0.05, 1}, {1, 0.05}};
+    uint64_t tileSize = 512;
+    std::string scratch = ".";
+    std::vector<std::string> multiply;
+    std::vector<uint64_t> chain;
+    int warmup = 1;
+    int reps = 5;
+    std::string output = "output_new.csv";
+    std::string format = "csv";
+    bool autotune = false;
+    bool mirror = false;
+    int tuneBudget = 64;
+
+    bool has(const std::string &engine) const
+    {
+        return std::find(engines.begin(), engines.end(), engine) != engines.end();
+    }
+};
+
+/**
+ * Split a comma separated list, e.g. "static,dynamic".
+ */
+std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if(!item.empty()) { items.push_back(item); }
+    }
+    return items;
+}
+
+/**
+ * Parse a comma separated list of numbers, e.g. "500,1000,2000".
+ */
+std::vector<uint64_t> parseNumbers(const std::string &list)
+{
+    std::vector<uint64_t> numbers;
+    for(const auto &item : splitList(list)) { numbers.push_back(std::stoull(item)); }
+    return numbers;
+}
+
+void printUsage()
+{
+    std::cout << "Usage: MatrixMulti.exe [options]\n"
+              << "  --sizes <n,...>        Matrix sizes (default 1000)\n"
+              << "  --engines <name,...>   sequential, sequential_transposed, parallel, parallel_transposed,\n"
+              << "                         tiled_l1, tiled_l2, tiled_l3, stealing, strassen, omp,\n"
+              << "                         omp_transposed, omp_packed, omp_recursive, gemm_threads, gemm_omp,\n"
+              << "                         sparse, out_of_core, chain, syrk_lower, syrk_upper (default all)\n"
+              << "  --threads <n,...>      Thread counts (default 2 up to the hardware threads)\n"
+              << "  --schedules <name,...> auto, static, dynamic, guided, tuned (default all)\n"
+              << "  --chunks <n,...>       OMP chunk sizes (default powers of 4 up to size / threads)\n"
+              << "  --shape <m,n,k>        Shape of the gemm engines, M x K times K x N (default size^3)\n"
+              << "  --batch <n>            Independent products per gemm run (default 1)\n"
+              << "  --densities <d,...>    Non-zero fractions of the sparse engine, d for both inputs\n"
+              << "                         or a:b for each (default 0.01,0.05:1,1:0.05)\n"
+              << "  --tile <n>             Tile edge of the out_of_core matrix files (default 512)\n"
+              << "  --scratch <dir>        Where out_of_core writes its files (default .)\n"
+              << "  --multiply <a,b,c>     Multiply matrix files a and b into c, then exit\n"
+              << "  --chain <d0,d1,...>    Dimensions of the chain engine, matrix i is di x di+1\n"
+              << "                         (default size, size/8, size, size/8, size)\n"
+              << "  --cost-model <file>    Results CSV with GEMM_OMP rows to fit the chain cost model to\n"
+              << "  --mirror               Time the syrk engines with the triangle mirrored to a full matrix\n"
+              << "  --warmup <n>           Untimed runs before each configuration (default 1)\n"
+              << "  --reps <n>             Timed runs per configuration (default 5)\n"
+              << "  --output <file>        Results file (default output_new.csv)\n"
+              << "  --format csv|json      CSV, or one JSON object per line (default csv)\n"
+              << "  --dtype <name>         Element type (default uint64)\n"
+              << "  --seed <n>             Seed of the input matrices\n"
+              << "  --verify exact         Recompute the product instead of Freivalds' check\n"
+              << "  --autotune             Tune the OMP schedule for every size and thread count, then exit\n"
+              << "  --tune-budget <n>      Timed multiplications per tuning (default 64)\n"
+              << "  --tuning-file <file>   Tuning file read by the tuned schedule (default omp_tuning.txt)\n"
+              << "  --counters off         Do not read hardware performance counters\n"
+              << "  --affinity compact|scatter, --cpus <list>   Pin threads, first-touch pages\n";
+}
+
+/**
+ * Parse the sparse densities, e.g. "0.01,0.05:1". A single number is the
+ * density of both inputs, a:b gives them separately.
+ */
+std::vector<std::pair<double, double>> parseDensities(const std::string &list)
+{
+    std::vector<std::pair<double, double>> densities;
+    for(const auto &item : splitList(list)) {
+        const auto colon = item.find(':');
+        if(colon == std::string::npos) {
+            densities.emplace_back(std::stod(item), std::stod(item));
+        } else {
+            densities.emplace_back(std::stod(item.substr(0, colon)), std::stod(item.substr(colon + 1)));
+        }
+    }
+    return densities;
+}
+
+/**
+ * Time one configuration: warm-up runs, then opts.reps timed runs.
+ * Verification time, work-stealing and hardware counters are averaged
+ * over the timed runs. A hardware counter missing from any run is
+ * reported as missing.
+ * @param opts: Repetition counts.
+ * @param result: Configuration to fill in; its time and counters are set here.
+ * @param runOnce: Runs the engine once and returns its time in microseconds.
+ * @param stats: If given, filled in by runOnce with the run's stealing statistics.
+ * @param name: If given, names the row after the last run, for engines
+ *              that pick their kernel at run time.
+ */
+testResults benchmark(const options &opts, testResults result, const std::function<uint64_t()> &runOnce,
+                      WorkStealing::Stats *stats = nullptr, const std::function<std::string()> &name = nullptr)
+{
+    uint64_t verifyTotal = 0, stealTotal = 0, idleTotal = 0;
+    PerfCounters::Counts counterTotal{};
+    result.warmup = opts.warmup;
+    result.time = Benchmark::measure(opts.warmup, opts.reps, [&](int rep) {
+        uint64_t time = runOnce();
+        if(rep >= 0) {
+            verifyTotal += Verification::lastMicroseconds();
+            for(int event = 0; event < PerfCounters::NumEvents; event++) {
+                const int64_t count = PerfCounters::last()[event];
+                counterTotal[event] = (count < 0 || counterTotal[event] < 0) ? -1 : counterTotal[event] + count;
+            }
+            if(stats != nullptr) {
+                stealTotal += stats->steals;
+                idleTotal += stats->idleMicroseconds;
+            }
+        }
+        return time;
+    });
 
-    uint64_t size = 1000;
+    const uint64_t reps = opts.reps > 0 ? opts.reps : 1;
+    result.verifyTime = verifyTotal / reps;
+    result.steals = stealTotal / reps;
+    result.idleTime = idleTotal / reps;
+    for(int event = 0; event < PerfCounters::NumEvents; event++) {
+        result.counters[event] = counterTotal[event] < 0 ? -1 : counterTotal[event] / static_cast<int64_t>(reps);
+    }
+    if(name) { result.type = name(); }
+    printTestResults(result);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+
+    // Every sweep dimension comes from the command line, see printUsage().
+    // Results are checked with Freivalds' algorithm unless --verify exact is given.
+    // Input matrices are derived from --seed (random if not given).
+    // Threads are pinned and pages placed by first touch with --affinity compact|scatter,
+    // or --cpus <list> to give the CPUs explicitly.
+    options opts;
+    for(int arg = 1; arg < argc; arg++) {
+        std::string flag = argv[arg];
+        if(flag == "--help" || flag == "-h") {
+            printUsage();
+            return 0;
+        } else if(flag == "--autotune") {
+            opts.autotune = true;
+            continue;
+        } else if(flag == "--mirror") {
+            opts.mirror = true;
+            continue;
+        } else if(arg + 1 >= argc) {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return 1;
+        }
+
+        std::string value = argv[++arg];
+        if(flag == "--dtype") {
+            opts.dtype = value;
+        } else if(flag == "--sizes") {
+            opts.sizes = parseNumbers(value);
+        } else if(flag == "--engines") {
+            opts.engines = splitList(value);
+        } else if(flag == "--threads") {
+            opts.threads = parseNumbers(value);
+        } else if(flag == "--schedules") {
+            opts.schedules = splitList(value);
+        } else if(flag == "--chunks") {
+            opts.chunks = parseNumbers(value);
+        } else if(flag == "--shape") {
+            opts.shape = parseNumbers(value);
+            if(opts.shape.size() != 3) {
+                std::cerr << "--shape takes three numbers: m,n,k" << std::endl;
+                return 1;
+            }
+        } else if(flag == "--batch") {
+            opts.batch = std::max(1, std::stoi(value));
+        } else if(flag == "--densities") {
+            opts.densities = parseDensities(value);
+        } else if(flag == "--tile") {
+            opts.tileSize = std::max<uint64_t>(1, std::stoull(value));
+        } else if(flag == "--scratch") {
+            opts.scratch = value;
+        } else if(flag == "--multiply") {
+            opts.multiply = splitList(value);
+            if(opts.multiply.size() != 3) {
+                std::cerr << "--multiply takes three files: a,b,c" << std::endl;
+                return 1;
+            }
+        } else if(flag == "--chain") {
+            opts.chain = parseNumbers(value);
+            if(opts.chain.size() < 2) {
+                std::cerr << "--chain takes at least two dimensions" << std::endl;
+                return 1;
+            }
+        } else if(flag == "--cost-model") {
+            ChainMultiplication::setCostModel(ChainMultiplication::CostModel::fromCSV(value, "GEMM_OMP"));
+        } else if(flag == "--warmup") {
+            opts.warmup = std::stoi(value);
+        } else if(flag == "--reps") {
+            opts.reps = std::max(1, std::stoi(value));
+        } else if(flag == "--output") {
+            opts.output = value;
+        } else if(flag == "--format") {
+            opts.format = value;
+        } else if(flag == "--seed") {
+            CounterRandom::setSeed(std::stoull(value));
+        } else if(flag == "--verify") {
+            Verification::setMode(value == "exact" ? Verification::Mode::Exact : Verification::Mode::Freivalds);
+        } else if(flag == "--tune-budget") {
+            opts.tuneBudget = std::max(1, std::stoi(value));
+        } else if(flag == "--tuning-file") {
+            Autotuner::setFile(value);
+        } else if(flag == "--counters") {
+            PerfCounters::setEnabled(value != "off");
+        } else if(flag == "--affinity") {
+            Affinity::setPolicy(Affinity::parsePolicy(value));
+        } else if(flag == "--cpus") {
+            Affinity::setPolicy(Affinity::Policy::Explicit, Affinity::parseCpuList(value));
+        } else {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
 
-    // Get maxThreads for current hardware.
+    // Multiply matrix files instead of benchmarking. The element type
+    // comes from the first file's header.
+    if(!opts.multiply.empty()) {
+        const MatrixFile::Header header = MatrixFile::readHeader(opts.multiply[0]);
+        opts.dtype = std::string(header.dtype, strnlen(header.dtype, sizeof(header.dtype)));
+    }
+
+    auto engine = dtypeTable().find(opts.dtype);
+    if(engine == dtypeTable().end()) {
+        std::cerr << "Unknown dtype: " << opts.dtype << ". Supported:";
+        for(const auto &entry : dtypeTable()) { std::cerr << " " << entry.first; }
+        std::cerr << std::endl;
+        return 1;
+    }
+    const dtypeEngines &engines = engine->second;
+    const std::string &dtype = opts.dtype;
+
+    // OMP schedule names, in the order OMPParallelMultiplication::run numbers them.
+    const std::vector<std::string> scheduleNames = {"auto", "static", "dynamic", "guided", "tuned"};
+    for(const auto &schedule : opts.schedules) {
+        if(std::find(scheduleNames.begin(), scheduleNames.end(), schedule) == scheduleNames.end()) {
+            std::cerr << "Unknown schedule: " << schedule << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Seed: " << CounterRandom::seed() << std::endl;
+    if(PerfCounters::available()) {
+        std::cout << "Hardware counters: on" << std::endl;
+    } else {
+        std::cout << "Hardware counters: off (" << PerfCounters::unavailableReason() << ")" << std::endl;
+    }
+    if(Affinity::enabled()) { std::cout << "NUMA nodes: " << Affinity::numNodes() << std::endl; }
+    // The packed SIMD and Strassen engines are only built for uint64_t.
+    const bool uint64Only = dtype == "uint64";
+    if(!uint64Only && (opts.has("strassen") || opts.has("omp_packed"))) {
+        std::cout << "Skipping strassen and omp_packed, they only support uint64." << std::endl;
+    }
+
+    // Default to every thread count from 2 up to the hardware threads.
     unsigned int maxThreads = std::thread::hardware_concurrency();
+    if(opts.threads.empty()) {
+        for(unsigned int th = 2; th <= maxThreads; th++) { opts.threads.push_back(th); }
+        if(opts.threads.empty()) { opts.threads.push_back(std::max(1u, maxThreads)); }
+    }
     std::vector<testResults> results;
 
-    // Test matrix multiplication for different matrix sizes
-    for(uint64_t minSize = size; minSize > 0; minSize -= 1000) {
-        std::cout << "Testing size: " << minSize << std::endl;
+    if(!opts.multiply.empty()) {
+        engines.multiplyFiles(opts.multiply[0], opts.multiply[1], opts.multiply[2], opts.threads.back());
+        return 0;
+    }
+
+    // Read cache sizes once up front, the tiled kernels derive their block sizes from them.
+    CacheInfo::print();
+
+    // Tune the OMP schedule instead of benchmarking. Later runs pick the
+    // result up through the "tuned" schedule.
+    if(opts.autotune) {
+        for(uint64_t size : opts.sizes) {
+            for(uint64_t th : opts.threads) { engines.tune(size, th, opts.tuneBudget); }
+        }
+        std::cout << "Saved tuning to " << Autotuner::file() << std::endl;
+        return 0;
+    }
+
+    // Test matrix multiplication for every requested size
+    for(uint64_t size : opts.sizes) {
+        std::cout << "Testing size: " << size << std::endl;
+
+        testResults base;
+        base.dtype = dtype;
+        base.size = size;
+        base.m = base.n = base.k = size;
 
         // Sequential test
-        testResults seq;
-        seq.type = "Sequential";
-        seq.numThreads = 1;
-        seq.time = SequentialMultiplication::run(minSize);
-        seq.size = minSize;
-        seq.chunkSize = minSize;
-        results.push_back(seq);
-
-        // Parallel tests for different thread counts
-        for (unsigned int th = 2; th <= maxThreads; th++) {
+        if(opts.has("sequential")) {
+            testResults seq = base;
+            seq.type = "Sequential";
+            seq.numThreads = 1;
+            seq.chunkSize = size;
+            results.push_back(benchmark(opts, seq, [&] { return engines.sequential(size, false); }));
+        }
+        if(opts.has("sequential_transposed")) {
+            testResults seq = base;
+            seq.type = "Sequential_TRANSPOSED";
+            seq.numThreads = 1;
+            seq.chunkSize = size;
+            results.push_back(benchmark(opts, seq, [&] { return engines.sequential(size, true); }));
+        }
+
+        // Strassen cutoff is tuned once per size, with all threads
+        uint64_t strassenCutoff = 0;
+        if(uint64Only && opts.has("strassen")) {
+            strassenCutoff = StrassenMultiplication::tuneCutoff(size, maxThreads);
+            std::cout << "Strassen cutoff: " << strassenCutoff << std::endl;
+        }
+
+        // Parallel tests for each thread count
+        for(uint64_t th : opts.threads) {
             std::cout << "Testing Threads: " << th << std::endl << std::endl;
 
-            testResults par;
-            par.type = "Parallel";
-            par.numThreads = th;
-            par.time = ParallelMultiplication::run(minSize, th);
-            par.size = minSize;
-            seq.chunkSize = minSize / th;
-            results.push_back(par);
-
-            // Iterate over and test different scheduling
-            // types - Auto, Static, Dynamic, Guided
-            for(int i = 0; i < 4; i++)
+            testResults threaded = base;
+            threaded.numThreads = th;
+            threaded.chunkSize = size / th;
+
+            // Plain rows, rows against a transposed B, and cache-blocked kernels tiled for each cache level
+            const std::tuple<std::string, ParallelMultiplication::TileMode, std::string> tileModes[] = {
+                {"parallel", ParallelMultiplication::TileMode::None, "Parallel"},
+                {"parallel_transposed", ParallelMultiplication::TileMode::Transposed, "Parallel_TRANSPOSED"},
+                {"tiled_l1", ParallelMultiplication::TileMode::L1, "Parallel_TILED_L1"},
+                {"tiled_l2", ParallelMultiplication::TileMode::L2, "Parallel_TILED_L2"},
+                {"tiled_l3", ParallelMultiplication::TileMode::L3, "Parallel_TILED_L3"},
+            };
+            for(const auto &[name, mode, type] : tileModes)
             {
-                testResults omp;
-                omp.type = "OMP";
-                omp.numThreads = th;
-                omp.size = minSize;
-                switch(i)
+                if(!opts.has(name)) { continue; }
+                testResults par = threaded;
+                par.type = type;
+                results.push_back(benchmark(opts, par, [&, mode = mode] {
+                    return engines.parallel(size, th, mode, false, nullptr);
+                }));
+            }
+
+            // Work-stealing over 2D output tiles
+            if(opts.has("stealing")) {
+                testResults stealing = threaded;
+                WorkStealing::Stats stats;
+                stealing.type = "Parallel_STEALING";
+                stealing.chunkSize = 0;
+                results.push_back(benchmark(opts, stealing, [&] {
+                    return engines.parallel(size, th, ParallelMultiplication::TileMode::WorkStealing, false, &stats);
+                }, &stats));
+            }
+
+            // Strassen-Winograd recursion over OMP tasks
+            if(uint64Only && opts.has("strassen")) {
+                testResults strassen = threaded;
+                strassen.type = "Strassen";
+                strassen.chunkSize = strassenCutoff;
+                results.push_back(benchmark(opts, strassen, [&] {
+                    return StrassenMultiplication::run(size, th, strassenCutoff);
+                }));
+            }
+
+            // Rectangular and batched products through the Gemm entry points,
+            // over the thread pool and over OpenMP
+            const std::tuple<std::string, Gemm::Backend, std::string> gemmBackends[] = {
+                {"gemm_threads", Gemm::Backend::Threads, "GEMM_THREADS"},
+                {"gemm_omp", Gemm::Backend::OMP, "GEMM_OMP"},
+            };
+            for(const auto &[name, backend, type] : gemmBackends)
+            {
+                if(!opts.has(name)) { continue; }
+                testResults gemm = threaded;
+                gemm.type = type;
+                gemm.chunkSize = 0;
+                if(!opts.shape.empty()) {
+                    gemm.m = opts.shape[0];
+                    gemm.n = opts.shape[1];
+                    gemm.k = opts.shape[2];
+                }
+                gemm.batch = opts.batch;
+                results.push_back(benchmark(opts, gemm, [&, backend = backend] {
+                    return engines.gemm(gemm.m, gemm.n, gemm.k, gemm.batch, th, backend);
+                }));
+            }
+
+            // Sparse inputs at each density, multiplied by whichever kernel the
+            // measured density selects. The row is named after that kernel.
+            if(opts.has("sparse")) {
+                for(const auto &[densityA, densityB] : opts.densities) {
+                    testResults sparse = threaded;
+                    sparse.type = "Sparse";
+                    sparse.chunkSize = 0;
+                    sparse.densityA = densityA;
+                    sparse.densityB = densityB;
+                    results.push_back(benchmark(opts, sparse, [&, densityA = densityA, densityB = densityB] {
+                        return engines.sparse(size, th, densityA, densityB);
+                    }, nullptr, [] {
+                        std::string kernel = SparseMultiplication::lastKernel();
+                        std::transform(kernel.begin(), kernel.end(), kernel.begin(), ::toupper);
+                        return "Sparse_" + kernel;
+                    }));
+                }
+            }
+
+            // Cache-oblivious recursion over OMP tasks. It has no schedule, the
+            // chunk size is its leaf size.
+            if(opts.has("omp_recursive")) {
+                testResults recursive = threaded;
+                recursive.type = "OMP_RECURSIVE";
+                recursive.chunkSize = OMPParallelMultiplication::recursiveLeaf;
+                results.push_back(benchmark(opts, recursive, [&] {
+                    return engines.omp(size, th, 0, static_cast<int>(OMPParallelMultiplication::recursiveLeaf),
+                                       OMPParallelMultiplication::Kernel::Recursive);
+                }));
+            }
+
+            // Matrix files streamed from disk tile by tile
+            if(opts.has("out_of_core")) {
+                testResults outOfCore = threaded;
+                outOfCore.type = "OutOfCore";
+                outOfCore.chunkSize = opts.tileSize;
+                results.push_back(benchmark(opts, outOfCore, [&] {
+                    return engines.outOfCore(size, th, opts.tileSize, opts.scratch);
+                }));
+            }
+
+            // A chain of mixed shapes, multiplied in the planned order. Its flops
+            // depend on the order, so the row has no k and no GFLOP/s.
+            if(opts.has("chain")) {
+                const uint64_t narrow = std::max<uint64_t>(1, size / 8);
+                const std::vector<uint64_t> dims = opts.chain.empty()
+                    ? std::vector<uint64_t>{size, narrow, size, narrow, size} : opts.chain;
+                testResults chain = threaded;
+                chain.type = "Chain";
+                chain.chunkSize = 0;
+                chain.m = dims.front();
+                chain.n = dims.back();
+                chain.k = 0;
+                results.push_back(benchmark(opts, chain, [&] { return engines.chain(dims, th); }));
+            }
+
+            // A * Aᵀ, one triangle over triangular tiles. GFLOP/s counts the
+            // full product, so the saving shows up as a higher rate.
+            const std::tuple<std::string, SyrkMultiplication::Triangle, std::string> triangles[] = {
+                {"syrk_lower", SyrkMultiplication::Triangle::Lower, "SYRK_LOWER"},
+                {"syrk_upper", SyrkMultiplication::Triangle::Upper, "SYRK_UPPER"},
+            };
+            for(const auto &[name, triangle, type] : triangles)
+            {
+                if(!opts.has(name)) { continue; }
+                testResults syrk = threaded;
+                syrk.type = type + std::string(opts.mirror ? "_MIRRORED" : "");
+                syrk.chunkSize = 0;
+                results.push_back(benchmark(opts, syrk, [&, triangle = triangle] {
+                    return engines.syrk(size, th, triangle, opts.mirror);
+                }));
+            }
+
+            // Chunk sizes to sweep: as given, or powers of 4 up to one chunk per thread.
+            std::vector<uint64_t> chunks = opts.chunks;
+            if(chunks.empty()) {
+                for(uint64_t chunk = 1; chunk <= std::max<uint64_t>(1, size / th); chunk *= 4) { chunks.push_back(chunk); }
+            }
+
+            // Test the requested scheduling types - Auto, Static, Dynamic, Guided, Tuned
+            for(const auto &schedule : opts.schedules)
+            {
+                const int scheduleType = static_cast<int>(std::find(scheduleNames.begin(), scheduleNames.end(), schedule)
+                                                          - scheduleNames.begin());
+                std::string suffix = schedule;
+                std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::toupper);
+
+                // Naive row kernel and the same kernel against a transposed B
+                const std::tuple<std::string, OMPParallelMultiplication::Kernel, std::string> kernels[] = {
+                    {"omp", OMPParallelMultiplication::Kernel::Naive, "OMP_"},
+                    {"omp_transposed", OMPParallelMultiplication::Kernel::Transposed, "OMP_TRANSPOSED_"},
+                };
+                testResults omp = threaded;
+                omp.schedule = schedule;
+                for(const auto &[name, kernel, prefix] : kernels)
                 {
-                    case 0:
-                        omp.type += "_AUTO";
-                        omp.chunkSize = -1;
-                        omp.time = OMPParallelMultiplication::run(minSize, th, i, -1);
-                        results.push_back(omp);
-                        break;
-                    case 1:
-                        omp.type += "_STATIC";
-                        // Iterate over different chunk sizes in 100 increments
-                        // if applicable to the type of schedule.
-                        for(int chunkSize = minSize; chunkSize >= 0; (chunkSize % 100 == 0) ? chunkSize -= 100 : chunkSize--)
-                        {
-                            omp.chunkSize = chunkSize;
-                            omp.time = OMPParallelMultiplication::run(minSize, th, i, chunkSize);
-                            results.push_back(omp);
-                        }
-                        break;
-                    case 2:
-                        omp.type += "_DYNAMIC";
-                        // Iterate over different chunk sizes in 100 increments
-                        // if applicable to the type of schedule.
-                        for(int chunkSize = minSize; chunkSize >= 1; (chunkSize % 100 == 0) ? chunkSize -= 100 : chunkSize--)
-                        {
-                            omp.chunkSize = chunkSize;
-                            omp.time = OMPParallelMultiplication::run(minSize, th, i, chunkSize);
-                            results.push_back(omp);
+                    if(!opts.has(name)) { continue; }
+                    omp.type = prefix + suffix;
+                    if(schedule == "auto" || schedule == "tuned") {
+                        // Auto picks its own chunks and tuned reads them from the
+                        // tuning file, there is nothing to sweep.
+                        omp.chunkSize = 0;
+                        results.push_back(benchmark(opts, omp, [&, kernel = kernel] {
+                            return engines.omp(size, th, scheduleType, 0, kernel);
+                        }));
+                    } else {
+                        for(uint64_t chunk : chunks) {
+                            omp.chunkSize = chunk;
+                            results.push_back(benchmark(opts, omp, [&, kernel = kernel] {
+                                return engines.omp(size, th, scheduleType, static_cast<int>(chunk), kernel);
+                            }));
                         }
-                        break;
-                    case 3:
-                        omp.type += "_GUIDED";
-                        // Iterate over different chunk sizes in 100 increments
-                        // if applicable to the type of schedule.
-                        for(int chunkSize = minSize; chunkSize >= 0; (chunkSize % 100 == 0) ? chunkSize -= 100 : chunkSize--)
-                        {
-                            omp.chunkSize = chunkSize;
-                            omp.time = OMPParallelMultiplication::run(minSize, th, i, chunkSize);
-                            results.push_back(omp);
-                        }
-                        break;
-
-                    default:
-                        // If we're here something has gone very wrong.
-                        throw new std::exception();
+                    }
                 }
+
+                // Packed SIMD engine under the same schedule. Chunks here are
+                // blocks of rows sized for L2, so a single chunk size is enough.
+                if(!uint64Only || !opts.has("omp_packed")) { continue; }
+                testResults packed = omp;
+                packed.type = "OMP_PACKED_" + suffix;
+                packed.chunkSize = 1;
+                results.push_back(benchmark(opts, packed, [&] {
+                    return OMPParallelMultiplication::run(size, th, scheduleType, 1,
+                                                          OMPParallelMultiplication::Kernel::Packed);
+                }));
             }
         }
     }
 
-    writeCSV("output_new.csv", results);
+    if(opts.format == "json") {
+        writeJSON(opts.output, results);
+    } else {
+        writeCSV(opts.output, results);
+    }
 
     return 0;
 }
@@ -0,0 +1,245 @@
+#include <utility>
+#include <vector>
+
+#include "Introsort.h"
+
+namespace Introsort {
+
+    static Settings current;
+
+    void setSettings(const Settings &settings)
+    {
+        current = settings;
+    }
+
+    const Settings &settings()
+    {
+        return current;
+    }
+    /**
+     * Number of quicksort levels allowed before the range is heapsorted,
+     * depthFactor * log2(size). Quicksort only goes deeper than this on
+     * inputs that keep picking bad pivots.
+     * @param size The number of elements to sort.
+     */
+    int depthLimit(int size)
+    {
+        int log = 0;
+        while(size > 1) {
+            size >>= 1;
+            log++;
+        }
+        return current.depthFactor * log;
+    }
+    /**
+     * Returns the index of the median of three elements.
+     */
+    static int medianIndex(int arr[], int a, int b, int c)
+    {
+        if(arr[a] < arr[b]) {
+            if(arr[b] < arr[c]) { return b; }
+            return arr[a] < arr[c] ? c : a;
+        }
+        if(arr[a] < arr[c]) { return a; }
+        return arr[b] < arr[c] ? c : b;
+    }
+    /**
+     * Moves the ninther, the median of the medians of three evenly spread
+     * triples, to arr[high] and returns it. A better pivot estimate than
+     * the median of three for large ranges.
+     * @param arr[] The array containing the integers.
+     * @param low The starting index of the range.
+     * @param high The ending index of the range.
+     */
+    int ninther(int arr[], int low, int high)
+    {
+        int step = (high - low) / 8;
+        int mid = low + (high - low) / 2;
+        int first = medianIndex(arr, low, low + step, low + 2 * step);
+        int middle = medianIndex(arr, mid - step, mid, mid + step);
+        int last = medianIndex(arr, high - 2 * step, high - step, high);
+        std::swap(arr[medianIndex(arr, first, middle, last)], arr[high]);
+        return arr[high];
+    }
+    /**
+     * Partitions arr[low..high-1] around the pivot already at arr[high],
+     * then moves the pivot between the two sides (BlockQuicksort). Each
+     * side is scanned a block at a time, storing the offsets of the
+     * elements on the wrong side in a small buffer without branching on the
+     * comparison. The buffered elements are then swapped pairwise. This
+     * avoids the branch mispredict Lomuto takes on about half of random
+     * inputs.
+     * @param arr[] The array to be partitioned.
+     * @param low The starting index of the portion to be partitioned.
+     * @param high The ending index of the portion to be partitioned, holding the pivot.
+     * @return The final index of the pivot.
+     */
+    int blockPartition(int arr[], int low, int high)
+    {
+        const int pivot = arr[high];
+        int offsetsLeft[partitionBlock];
+        int offsetsRight[partitionBlock];
+        int countLeft = 0, countRight = 0;
+        int startLeft = 0, startRight = 0;
+
+        // Everything left of l is below the pivot, everything right of r is not.
+        int l = low;
+        int r = high - 1;
+        while(r - l + 1 > 2 * partitionBlock)
+        {
+            if(countLeft == 0) {
+                startLeft = 0;
+                for(int i = 0; i < partitionBlock; i++)
+                {
+                    offsetsLeft[countLeft] = i;
+                    countLeft += !(arr[l + i] < pivot);
+                }
+            }
+            if(countRight == 0) {
+                startRight = 0;
+                for(int i = 0; i < partitionBlock; i++)
+                {
+                    offsetsRight[countRight] = i;
+                    countRight += arr[r - i] < pivot;
+                }
+            }
+
+            int count = countLeft < countRight ? countLeft : countRight;
+            for(int k = 0; k < count; k++)
+            {
+                std::swap(arr[l + offsetsLeft[startLeft + k]], arr[r - offsetsRight[startRight + k]]);
+            }
+            countLeft -= count;
+            countRight -= count;
+            startLeft += count;
+            startRight += count;
+            if(countLeft == 0) { l += partitionBlock; }
+            if(countRight == 0) { r -= partitionBlock; }
+        }
+
+        // At most two blocks are left, one maybe half done. Finish them plainly.
+        int i = l;
+        for(int j = l; j <= r; j++)
+        {
+            if(arr[j] < pivot) { std::swap(arr[i++], arr[j]); }
+        }
+        std::swap(arr[i], arr[high]);
+        return i;
+    }
+    /**
+     * Partitions arr[low..high] around the pivot already at arr[high] into
+     * elements below, equal to and above it (Bentley-McIlroy). Keys equal
+     * to the pivot are swapped to the two ends while scanning and moved to
+     * the middle at the end, so they are never looked at again, where a
+     * two-way partition keeps recursing into ranges of one repeated key.
+     * @param arr[] The array to be partitioned.
+     * @param low The starting index of the portion to be partitioned.
+     * @param high The ending index of the portion to be partitioned, holding the pivot.
+     * @param lowPart Set to the last index of the elements below the pivot.
+     * @param highPart Set to the first index of the elements above the pivot.
+     */
+    void threeWayPartition(int arr[], int low, int high, int &lowPart, int &highPart)
+    {
+        const int pivot = arr[high];
+        // [low, p] and [q, high) hold keys equal to the pivot, (p, i) keys
+        // below it and (j, q) keys above it.
+        int i = low - 1, j = high;
+        int p = low - 1, q = high;
+        while(true)
+        {
+            while(arr[++i] < pivot) {}
+            // Check the bound before stepping, low == high has nothing left of the pivot.
+            while(j > low && pivot < arr[--j]) {}
+            if(i >= j) { break; }
+            std::swap(arr[i], arr[j]);
+            if(arr[i] == pivot) { std::swap(arr[++p], arr[i]); }
+            if(arr[j] == pivot) { std::swap(arr[--q], arr[j]); }
+        }
+        std::swap(arr[i], arr[high]);
+
+        // Swap the equal keys from the ends into the middle.
+        j = i - 1;
+        i = i + 1;
+        for(int k = low; k <= p; k++, j--) { std::swap(arr[k], arr[j]); }
+        for(int k = high - 1; k >= q; k--, i++) { std::swap(arr[i], arr[k]); }
+        lowPart = j;
+        highPart = i;
+    }
+    /**
+     * Estimates how duplicate-heavy a range is: the fraction of an evenly
+     * spread sample of duplicateSamples elements that equal the sampled
+     * element before them once the sample is sorted. About 0 for distinct
+     * keys and grows as the number of distinct keys falls towards the
+     * sample size.
+     * @param arr[] The array to be sampled.
+     * @param low The starting index of the range.
+     * @param high The ending index of the range.
+     */
+    double duplicateRatio(const int arr[], int low, int high)
+    {
+        const int size = high - low + 1;
+        const int samples = size < current.duplicateSamples ? size : current.duplicateSamples;
+        if(samples < 2) { return 0; }
+        std::vector<int> sample(samples);
+        for(int s = 0; s < samples; s++) { sample[s] = arr[low + static_cast<long long>(s) * size / samples]; }
+        heapSort(sample.data(), 0, samples - 1);
+
+        int duplicates = 0;
+        for(int s = 1; s < samples; s++) { duplicates += sample[s] == sample[s - 1]; }
+        return static_cast<double>(duplicates) / samples;
+    }
+    /**
+     * Sorts a small range by insertion, which beats quicksort below a few
+     * dozen elements.
+     * @param arr[] The array to be sorted.
+     * @param low The starting index of the sorting range.
+     * @param high The ending index of the sorting range.
+     */
+    void insertionSort(int arr[], int low, int high)
+    {
+        for(int i = low + 1; i <= high; i++)
+        {
+            int value = arr[i];
+            int j = i - 1;
+            while(j >= low && arr[j] > value)
+            {
+                arr[j + 1] = arr[j];
+                j--;
+            }
+            arr[j + 1] = value;
+        }
+    }
+    /**
+     * Moves arr[low + root] down the max-heap stored in arr[low..low+size-1].
+     */
+    static void siftDown(int arr[], int low, int root, int size)
+    {
+        int value = arr[low + root];
+        while(2 * root + 1 < size)
+        {
+            int child = 2 * root + 1;
+            if(child + 1 < size && arr[low + child] < arr[low + child + 1]) { child++; }
+            if(arr[low + child] <= value) { break; }
+            arr[low + root] = arr[low + child];
+            root = child;
+        }
+        arr[low + root] = value;
+    }
+    /**
+     * Sorts a range by heapsort, O(n log n) whatever the input. Used once
+     * quicksort passes its depth limit.
+     * @param arr[] The array to be sorted.
+     * @param low The starting index of the sorting range.
+     * @param high The ending index of the sorting range.
+     */
+    void heapSort(int arr[], int low, int high)
+    {
+        int size = high - low + 1;
+        for(int root = size / 2 - 1; root >= 0; root--) { siftDown(arr, low, root, size); }
+        for(int end = size - 1; end > 0; end--)
+        {
+            std::swap(arr[low], arr[low + end]);
+            siftDown(arr, low, 0, end);
+        }
+    }
+}
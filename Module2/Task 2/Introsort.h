@@ -0,0 +1,48 @@
+#ifndef INTROSORT_H
+#define INTROSORT_H
+
+namespace Introsort
+{
+    // How a range is split around its pivot, see blockPartition().
+    enum class Partition { Lomuto, Block };
+
+    // Elements per offset buffer of blockPartition().
+    const int partitionBlock = 64;
+
+    /**
+     * Thresholds shared by the sequential and parallel quicksorts, set
+     * from main.cpp.
+     */
+    struct Settings
+    {
+        // Ranges of at most this many elements are insertion sorted.
+        int insertionCutoff = 16;
+        // Ranges of at most this many elements are sorted by one task, serially.
+        int taskCutoff = 1 << 14;
+        // Ranges of more than this many elements take the ninther as pivot.
+        int nintherThreshold = 128;
+        // Ranges of more than this many elements are partitioned by the whole team.
+        int parallelThreshold = 1 << 16;
+        // Quicksort levels allowed, times log2 of the size, before heapsort takes over.
+        int depthFactor = 2;
+        // Partition used below parallelThreshold.
+        Partition partition = Partition::Block;
+        // Elements sampled to estimate the duplicate ratio.
+        int duplicateSamples = 1024;
+        // Sorts of inputs with a higher duplicate ratio partition three ways.
+        double duplicateThreshold = 0.05;
+    };
+
+    void setSettings(const Settings &settings);
+    const Settings &settings();
+
+    int depthLimit(int size);
+    int ninther(int arr[], int low, int high);
+    int blockPartition(int arr[], int low, int high);
+    void threeWayPartition(int arr[], int low, int high, int &lowPart, int &highPart);
+    double duplicateRatio(const int arr[], int low, int high);
+    void insertionSort(int arr[], int low, int high);
+    void heapSort(int arr[], int low, int high);
+}
+
+#endif
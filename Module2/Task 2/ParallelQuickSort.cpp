@@ -1,6 +1,9 @@
 #include <omp.h>
+#include <algorithm>
 
 #include "ParallelQuickSort.h"
+#include "SequentialQuickSort.h"
+#include "Introsort.h"
 
 namespace ParallelQuickSort {
 
@@ -39,7 +42,11 @@ namespace ParallelQuickSort {
      */
     int partition(int arr[], int low, int high)
     {
-        int pivot = medianOfThree(arr, low, high);
+        int pivot = high - low > Introsort::settings().nintherThreshold ? Introsort::ninther(arr, low, high)
+                                                                        : medianOfThree(arr, low, high);
+        if(Introsort::settings().partition == Introsort::Partition::Block) {
+            return Introsort::blockPartition(arr, low, high);
+        }
         int i = (low - 1);
         for(int j = low; j <= high - 1; j++)
         {
@@ -53,33 +60,205 @@ namespace ParallelQuickSort {
         return (i + 1);
     }
     /**
-     * Sorts the array using the quicksort algorithm in parallel.
+     * Swaps the blocks a thread left unfinished to the inner end of the
+     * blocks claimed from one side, so that with the unclaimed middle they
+     * form a single range.
+     * @param arr[] The array being partitioned.
+     * @param open The unfinished blocks.
+     * @param claimed The number of blocks claimed from this side.
+     * @param origin The index the blocks on this side are counted from.
+     * @param fromRight Whether the blocks are counted back from origin.
+     */
+    void gatherBlocks(int arr[], std::vector<int> &open, int claimed, int origin, bool fromRight)
+    {
+        auto start = [&](int block) {
+            return fromRight ? origin - (block + 1) * blockSize : origin + block * blockSize;
+        };
+        const int inner = claimed - static_cast<int>(open.size());
+        std::vector<bool> isOpen(claimed, false);
+        for(int block : open) { isOpen[block] = true; }
+
+        // Every open block outside the inner slots pairs up with a finished
+        // block inside them.
+        int target = inner;
+        for(int block : open)
+        {
+            if(block >= inner) { continue; }
+            while(isOpen[target]) { target++; }
+            std::swap_ranges(arr + start(block), arr + start(block) + blockSize, arr + start(target));
+            target++;
+        }
+    }
+    /**
+     * Partitions the array like partition(), with every thread of the
+     * current team helping (Tsigas-Zhang). Each thread claims a block from
+     * either end and swaps the elements on the wrong side between them
+     * until one block is done, then claims the next block for that end.
+     * The blocks left unfinished when none remain are gathered next to the
+     * unclaimed middle and partitioned sequentially.
+     * Must be called from inside a parallel region, e.g. from quickSort.
+     * @param arr[] The array to be partitioned.
+     * @param low The starting index of the portion to be partitioned.
+     * @param high The ending index of the portion to be partitioned.
+     */
+    int parallelPartition(int arr[], int low, int high)
+    {
+        // The pivot stays at arr[high] until the end, the blocks cover the rest.
+        int pivot = Introsort::ninther(arr, low, high);
+        const int blocks = (high - low) / blockSize;
+        int leftNext = 0;
+        int rightNext = 0;
+        std::vector<int> leftOpen;
+        std::vector<int> rightOpen;
+
+        const int threads = omp_get_num_threads();
+        for(int t = 0; t < threads; t++)
+        {
+#pragma omp task default(none) shared(arr, leftNext, rightNext, leftOpen, rightOpen) firstprivate(low, high, pivot, blocks)
+            {
+                // Blocks held and the next index to look at in each. The
+                // right block is scanned from its top down.
+                int left = -1, right = -1;
+                int i = 0, j = 0;
+                while(true)
+                {
+                    if(left < 0) {
+#pragma omp critical(partitionBlocks)
+                        {
+                            if(leftNext + rightNext < blocks) { left = leftNext++; }
+                        }
+                        if(left < 0) { break; }
+                        i = low + left * blockSize;
+                    }
+                    if(right < 0) {
+#pragma omp critical(partitionBlocks)
+                        {
+                            if(leftNext + rightNext < blocks) { right = rightNext++; }
+                        }
+                        if(right < 0) { break; }
+                        j = high - right * blockSize - 1;
+                    }
+
+                    const int leftEnd = low + (left + 1) * blockSize;
+                    const int rightEnd = high - (right + 1) * blockSize;
+                    while(i < leftEnd && j >= rightEnd)
+                    {
+                        while(i < leftEnd && arr[i] < pivot) { i++; }
+                        while(j >= rightEnd && arr[j] >= pivot) { j--; }
+                        if(i < leftEnd && j >= rightEnd) { swap(arr[i++], arr[j--]); }
+                    }
+                    if(i == leftEnd) { left = -1; }
+                    if(j < rightEnd) { right = -1; }
+                }
+
+#pragma omp critical(partitionBlocks)
+                {
+                    if(left >= 0) { leftOpen.push_back(left); }
+                    if(right >= 0) { rightOpen.push_back(right); }
+                }
+            }
+        }
+#pragma omp taskwait
+
+        // Cleanup: everything left of from is below the pivot, everything
+        // from to up is not.
+        gatherBlocks(arr, leftOpen, leftNext, low, false);
+        gatherBlocks(arr, rightOpen, rightNext, high, true);
+        const int from = low + (leftNext - static_cast<int>(leftOpen.size())) * blockSize;
+        const int to = high - (rightNext - static_cast<int>(rightOpen.size())) * blockSize;
+        int i = from;
+        for(int j = from; j < to; j++)
+        {
+            if(arr[j] < pivot) { swap(arr[i++], arr[j]); }
+        }
+        swap(arr[i], arr[high]);
+        return i;
+    }
+    /**
+     * Partitions the array into the elements smaller than the pivot, equal
+     * to it and larger, for inputs with many duplicate keys.
+     * @param arr[] The array to be partitioned.
+     * @param low The starting index of the portion to be partitioned.
+     * @param high The ending index of the portion to be partitioned.
+     * @param lowPart Set to the last index of the elements smaller than the pivot.
+     * @param highPart Set to the first index of the elements larger than the pivot.
+     */
+    void threeWayPartition(int arr[], int low, int high, int &lowPart, int &highPart)
+    {
+        if(high - low > Introsort::settings().nintherThreshold) { Introsort::ninther(arr, low, high); }
+        else { medianOfThree(arr, low, high); }
+        Introsort::threeWayPartition(arr, low, high, lowPart, highPart);
+    }
+    /**
+     * Sorts the array using the quicksort algorithm in parallel. Ranges of
+     * up to taskCutoff elements are left to one task and sorted serially.
      * @param arr[] The array to be sorted.
      * @param low The starting index of the sorting range.
      * @param high The ending index of the sorting range.
+     * @param depthLimit The quicksort levels left before heapsort.
+     * @param threeWay Whether to group keys equal to the pivot.
      */
-    void quickSort(int arr[], int low, int high)
+    void introSort(int arr[], int low, int high, int depthLimit, bool threeWay)
     {
+        const Introsort::Settings &settings = Introsort::settings();
         while(low < high) {
-            int part = partition(arr, low, high);
-
-            int lowPart = part - 1;
-            int highPart = part + 1;
+            if(high - low + 1 <= settings.taskCutoff) {
+                SequentialQuickSort::introSort(arr, low, high, depthLimit, threeWay);
+                return;
+            }
+            if(depthLimit-- == 0) {
+                Introsort::heapSort(arr, low, high);
+                return;
+            }
+            // Large subarrays are partitioned by the whole team, so every
+            // thread has work from the first level down. That partition is
+            // two-way, duplicates are grouped once ranges are smaller.
+            int lowPart, highPart;
+            if(threeWay && high - low <= settings.parallelThreshold) {
+                threeWayPartition(arr, low, high, lowPart, highPart);
+            } else {
+                int part = high - low > settings.parallelThreshold ? parallelPartition(arr, low, high)
+                                                                   : partition(arr, low, high);
+                lowPart = part - 1;
+                highPart = part + 1;
+            }
             //Sort smaller array first
-            if(part - low < high - part)
+            if(lowPart - low < high - highPart)
             {
                 // We create a task for the call to quickSort for
                 // the smaller sub-array, spawning off threads for them.
                 // The main thread continues with the larger sub-array
-                // and partitions it.
-#pragma omp task default(none) shared(arr) firstprivate(low, lowPart)
-                quickSort(arr, low, lowPart);
+                // and partitions it. Sub-arrays no larger than the task
+                // cutoff are not worth a task and are sorted here.
+                if(lowPart - low + 1 <= settings.taskCutoff) {
+                    SequentialQuickSort::introSort(arr, low, lowPart, depthLimit, threeWay);
+                } else {
+#pragma omp task default(none) shared(arr) firstprivate(low, lowPart, depthLimit, threeWay)
+                    introSort(arr, low, lowPart, depthLimit, threeWay);
+                }
                 low = highPart;
             } else {
-#pragma omp task default(none) shared(arr) firstprivate(high, highPart)
-                quickSort(arr, highPart, high);
+                if(high - highPart + 1 <= settings.taskCutoff) {
+                    SequentialQuickSort::introSort(arr, highPart, high, depthLimit, threeWay);
+                } else {
+#pragma omp task default(none) shared(arr) firstprivate(high, highPart, depthLimit, threeWay)
+                    introSort(arr, highPart, high, depthLimit, threeWay);
+                }
                 high = lowPart;
             }
         }
     }
+    /**
+     * Sorts the array using the quicksort algorithm in parallel.
+     * @param arr[] The array to be sorted.
+     * @param low The starting index of the sorting range.
+     * @param high The ending index of the sorting range.
+     */
+    void quickSort(int arr[], int low, int high)
+    {
+        // Sample the input once to decide whether duplicates are common
+        // enough to be worth grouping.
+        bool threeWay = Introsort::duplicateRatio(arr, low, high) > Introsort::settings().duplicateThreshold;
+        introSort(arr, low, high, Introsort::depthLimit(high - low + 1), threeWay);
+    }
 }
\ No newline at end of file
@@ -3,11 +3,20 @@
 #ifndef PARALLEL_QUICKSORT_H
 #define PARALLEL_QUICKSORT_H
 
+#include <vector>
+
 namespace ParallelQuickSort
 {
+    // Elements per block of the parallel partition.
+    const int blockSize = 1024;
+
     void swap(int &a, int &b);
     int medianOfThree(int arr[], int low, int high);
     int partition(int arr[], int low, int high);
+    void gatherBlocks(int arr[], std::vector<int> &open, int claimed, int origin, bool fromRight);
+    int parallelPartition(int arr[], int low, int high);
+    void threeWayPartition(int arr[], int low, int high, int &lowPart, int &highPart);
+    void introSort(int arr[], int low, int high, int depthLimit, bool threeWay);
     void quickSort(int arr[], int low, int high);
 }
 
@@ -0,0 +1,135 @@
+#include <omp.h>
+#include <vector>
+#include <cstring>
+
+#include "RadixSort.h"
+
+namespace RadixSort {
+
+    /**
+     * Returns the digit of a key at the given shift. The sign bit is
+     * flipped first, so negative keys order below positive ones as
+     * unsigned numbers.
+     * @param value The key.
+     * @param shift The position of the lowest bit of the digit.
+     * @param mask The digit mask, the radix minus one.
+     */
+    int digit(int value, int shift, int mask)
+    {
+        unsigned key = static_cast<unsigned>(value) ^ 0x80000000u;
+        return static_cast<int>((key >> shift) & static_cast<unsigned>(mask));
+    }
+    /**
+     * Sorts the array with a parallel least-significant-digit radix sort.
+     * Each pass every thread counts the digits in its share of the array,
+     * the counts are turned into per-thread write offsets by a parallel
+     * prefix sum, and each thread scatters its keys to them. Keys are
+     * gathered a cache line at a time per digit before being written, so
+     * the scatter writes whole lines instead of single ints to up to 2048
+     * places. Passes where every key has the same digit are skipped.
+     * @param arr[] The array to be sorted.
+     * @param low The starting index of the sorting range.
+     * @param high The ending index of the sorting range.
+     * @param digitBits Bits per digit, 8 (four passes) or 11 (three passes).
+     */
+    void sort(int arr[], int low, int high, int digitBits)
+    {
+        const int size = high - low + 1;
+        if(size < 2) { return; }
+        const int radix = 1 << digitBits;
+        const int mask = radix - 1;
+        std::vector<int> buffer(size);
+        int *src = arr + low;
+        int *dst = buffer.data();
+
+        const int threads = omp_get_max_threads();
+        // counts[t * radix + d]: keys with digit d in thread t's share,
+        // turned into where thread t writes its first key with digit d.
+        std::vector<int> counts(static_cast<size_t>(threads) * radix);
+        std::vector<int> totals(radix);
+
+#pragma omp parallel default(none) shared(src, dst, counts, totals) firstprivate(size, radix, mask, digitBits) num_threads(threads)
+        {
+            const int team = omp_get_num_threads();
+            const int t = omp_get_thread_num();
+            const int begin = static_cast<int>(static_cast<long long>(size) * t / team);
+            const int end = static_cast<int>(static_cast<long long>(size) * (t + 1) / team);
+            int *count = counts.data() + static_cast<size_t>(t) * radix;
+            std::vector<int> lines(static_cast<size_t>(radix) * bufferSize);
+            std::vector<int> filled(radix);
+
+            for(int shift = 0; shift < 32; shift += digitBits)
+            {
+                std::memset(count, 0, radix * sizeof(int));
+                for(int i = begin; i < end; i++) { count[digit(src[i], shift, mask)]++; }
+#pragma omp barrier
+
+                // Prefix sum, in parallel over the digits: the offset of each
+                // thread within a digit, then the start of each digit.
+#pragma omp for
+                for(int d = 0; d < radix; d++)
+                {
+                    int sum = 0;
+                    for(int u = 0; u < team; u++)
+                    {
+                        int c = counts[static_cast<size_t>(u) * radix + d];
+                        counts[static_cast<size_t>(u) * radix + d] = sum;
+                        sum += c;
+                    }
+                    totals[d] = sum;
+                }
+#pragma omp single
+                {
+                    int start = 0;
+                    for(int d = 0; d < radix; d++)
+                    {
+                        int c = totals[d];
+                        totals[d] = start;
+                        start += c;
+                    }
+                }
+
+                // When every key has the same digit nothing would move.
+                // All threads see the same totals, so all skip together.
+                bool skip = false;
+                for(int d = 0; d < radix; d++)
+                {
+                    int next = d + 1 < radix ? totals[d + 1] : size;
+                    if(next - totals[d] == size) { skip = true; }
+                }
+                if(skip) { continue; }
+
+                for(int d = 0; d < radix; d++) { count[d] += totals[d]; }
+                for(int i = begin; i < end; i++)
+                {
+                    int d = digit(src[i], shift, mask);
+                    int *line = lines.data() + static_cast<size_t>(d) * bufferSize;
+                    line[filled[d]++] = src[i];
+                    if(filled[d] == bufferSize) {
+                        std::memcpy(dst + count[d], line, bufferSize * sizeof(int));
+                        count[d] += bufferSize;
+                        filled[d] = 0;
+                    }
+                }
+                for(int d = 0; d < radix; d++)
+                {
+                    std::memcpy(dst + count[d], lines.data() + static_cast<size_t>(d) * bufferSize, filled[d] * sizeof(int));
+                    filled[d] = 0;
+                }
+#pragma omp barrier
+#pragma omp single
+                {
+                    int *swap = src;
+                    src = dst;
+                    dst = swap;
+                }
+            }
+        }
+
+        // An odd number of passes leaves the keys in the buffer.
+        if(src != arr + low) {
+#pragma omp parallel for default(none) shared(arr, src) firstprivate(low, size) num_threads(threads)
+            for(int i = 0; i < size; i++) { arr[low + i] = src[i]; }
+        }
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+namespace RadixSort
+{
+    // Ints per write-combining buffer, one 64 byte cache line.
+    const int bufferSize = 16;
+
+    int digit(int value, int shift, int mask);
+    void sort(int arr[], int low, int high, int digitBits);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "SequentialQuickSort.h"
+#include "Introsort.h"
 
 namespace SequentialQuickSort {
     void swap(int &a, int &b)
@@ -36,7 +37,11 @@ namespace SequentialQuickSort {
      */
     int partition(int arr[], int low, int high)
     {
-        int pivot = medianOfThree(arr, low, high);
+        int pivot = high - low > Introsort::settings().nintherThreshold ? Introsort::ninther(arr, low, high)
+                                                                        : medianOfThree(arr, low, high);
+        if(Introsort::settings().partition == Introsort::Partition::Block) {
+            return Introsort::blockPartition(arr, low, high);
+        }
         int i = (low - 1);
         for(int j = low; j <= high - 1; j++)
         {
@@ -50,32 +55,73 @@ namespace SequentialQuickSort {
         return (i + 1);
     }
     /**
-     * Sorts the array using the quicksort algorithm sequentially.
+     * Partitions the array into the elements smaller than the pivot, equal
+     * to it and larger, for inputs with many duplicate keys.
+     * @param arr[] The array to be partitioned.
+     * @param low The starting index of the portion to be partitioned.
+     * @param high The ending index of the portion to be partitioned.
+     * @param lowPart Set to the last index of the elements smaller than the pivot.
+     * @param highPart Set to the first index of the elements larger than the pivot.
+     */
+    void threeWayPartition(int arr[], int low, int high, int &lowPart, int &highPart)
+    {
+        if(high - low > Introsort::settings().nintherThreshold) { Introsort::ninther(arr, low, high); }
+        else { medianOfThree(arr, low, high); }
+        Introsort::threeWayPartition(arr, low, high, lowPart, highPart);
+    }
+    /**
+     * Sorts the array using the quicksort algorithm sequentially, with
+     * insertion sort for small ranges and heapsort once depthLimit levels
+     * have been used up.
      * @param arr[] The array to be sorted.
      * @param low The starting index of the sorting range.
      * @param high The ending index of the sorting range.
+     * @param depthLimit The quicksort levels left before heapsort.
+     * @param threeWay Whether to group keys equal to the pivot.
      */
-    void quickSort(int arr[], int low, int high)
+    void introSort(int arr[], int low, int high, int depthLimit, bool threeWay)
     {
-        while(low < high) {
-            int part = partition(arr, low, high);
-            int lowPart = part - 1;
-            int highPart = part + 1;
+        while(high - low + 1 > Introsort::settings().insertionCutoff) {
+            if(depthLimit-- == 0) {
+                Introsort::heapSort(arr, low, high);
+                return;
+            }
+            int lowPart, highPart;
+            if(threeWay) {
+                threeWayPartition(arr, low, high, lowPart, highPart);
+            } else {
+                int part = partition(arr, low, high);
+                lowPart = part - 1;
+                highPart = part + 1;
+            }
             // Sort the smallest array first.
-            if(part - low < high - part)
+            if(lowPart - low < high - highPart)
             {
                 // Once we sort the smallest sub-array
                 // (and then therefore it's further recursive calls)
                 // we then set the lower bound of the range to now
                 // partition the larger array WITHOUT making another
                 // recursive call.
-                quickSort(arr, low, lowPart);
+                introSort(arr, low, lowPart, depthLimit, threeWay);
                 low = highPart;
             } else {
-                quickSort(arr, highPart, high);
+                introSort(arr, highPart, high, depthLimit, threeWay);
                 high = lowPart;
             }
         }
-
+        Introsort::insertionSort(arr, low, high);
+    }
+    /**
+     * Sorts the array using the quicksort algorithm sequentially.
+     * @param arr[] The array to be sorted.
+     * @param low The starting index of the sorting range.
+     * @param high The ending index of the sorting range.
+     */
+    void quickSort(int arr[], int low, int high)
+    {
+        // Sample the input once to decide whether duplicates are common
+        // enough to be worth grouping.
+        bool threeWay = Introsort::duplicateRatio(arr, low, high) > Introsort::settings().duplicateThreshold;
+        introSort(arr, low, high, Introsort::depthLimit(high - low + 1), threeWay);
     }
 }
\ No newline at end of file
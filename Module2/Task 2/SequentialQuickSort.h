@@ -8,6 +8,8 @@ namespace SequentialQuickSort {
     void swap(int &a, int &b);
     int medianOfThree(int arr[], int low, int high);
     int partition(int arr[], int low, int high);
+    void threeWayPartition(int arr[], int low, int high, int &lowPart, int &highPart);
+    void introSort(int arr[], int low, int high, int depthLimit, bool threeWay);
     void quickSort(int arr[], int low, int high);
 }
 
@@ -1,2 +1,2 @@
-g++ -fopenmp main.cpp ParallelQuickSort.cpp ParallelQuickSort.h SequentialQuickSort.cpp SequentialQuickSort.h -o Quicksort.exe
+g++ -fopenmp main.cpp ParallelQuickSort.cpp ParallelQuickSort.h SequentialQuickSort.cpp SequentialQuickSort.h Introsort.cpp Introsort.h RadixSort.cpp RadixSort.h -o Quicksort.exe
 
@@ -7,12 +7,15 @@
 #include <string>
 #include "SequentialQuickSort.h"
 #include "ParallelQuickSort.h"
+#include "Introsort.h"
+#include "RadixSort.h"
 
 struct taskData{
     std::string type;
     double duration;
     int size;
     bool sorted;
+    double duplicateRatio;
 };
 
 /**
@@ -74,16 +77,135 @@ bool isSorted(int arr[], int sz)
 }
 
 /**
- * @brief Writes task data to a CSV file.
+ * @brief Appends task data to a CSV file, writing the header first if the
+ * file is new or empty.
+ * @param path The CSV file.
  * @param data The task data to be written to the file.
  */
-void writeCSV(taskData data) {
-    std::ofstream outfile("results.csv", std::ios_base::app);
-    outfile << data.type << "," << data.size << "," << data.duration << "," << std::boolalpha << data.sorted << std::endl;
+void writeCSV(const std::string &path, taskData data) {
+    std::ofstream outfile(path, std::ios_base::app);
+    if(outfile.tellp() == 0) {
+        outfile << "type,size,duration,sorted,duplicate_ratio" << std::endl;
+    }
+    outfile << data.type << "," << data.size << "," << data.duration << "," << std::boolalpha << data.sorted
+            << "," << data.duplicateRatio << std::endl;
     outfile.close();
 }
 
-int main() {
+/**
+ * What to run, from the command line.
+ */
+struct options
+{
+    Introsort::Settings settings;
+    bool sequential = true;
+    bool parallel = true;
+    bool radix = true;
+    int radixBits = 8;
+    // Results CSV, none if empty.
+    std::string output;
+};
+
+/**
+ * Reads the options from the command line, e.g. --sorts parallel,radix --output results.csv
+ * --insertion-cutoff 24 --task-cutoff 8192 --partition lomuto. Unset ones keep their defaults.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param opts The options to update.
+ * @return Whether every argument was understood.
+ */
+bool parseOptions(int argc, char *argv[], options &opts)
+{
+    Introsort::Settings &settings = opts.settings;
+    for(int arg = 1; arg < argc; arg += 2)
+    {
+        std::string flag = argv[arg];
+        if(arg + 1 >= argc) { return false; }
+        std::string value = argv[arg + 1];
+        if(flag == "--partition" && (value == "lomuto" || value == "block"))
+        {
+            settings.partition = value == "block" ? Introsort::Partition::Block : Introsort::Partition::Lomuto;
+        }
+        else if(flag == "--sorts")
+        {
+            std::string list = "," + value + ",";
+            opts.sequential = list.find(",sequential,") != std::string::npos;
+            opts.parallel = list.find(",parallel,") != std::string::npos;
+            opts.radix = list.find(",radix,") != std::string::npos;
+        }
+        else if(flag == "--output") { opts.output = value; }
+        else if(flag == "--radix-bits" && (value == "8" || value == "11")) { opts.radixBits = std::stoi(value); }
+        else if(flag == "--insertion-cutoff") { settings.insertionCutoff = std::stoi(value); }
+        else if(flag == "--task-cutoff") { settings.taskCutoff = std::stoi(value); }
+        else if(flag == "--ninther-threshold") { settings.nintherThreshold = std::stoi(value); }
+        else if(flag == "--parallel-threshold") { settings.parallelThreshold = std::stoi(value); }
+        else if(flag == "--depth-factor") { settings.depthFactor = std::stoi(value); }
+        else if(flag == "--duplicate-threshold") { settings.duplicateThreshold = std::stod(value); }
+        else { return false; }
+    }
+    return true;
+}
+
+/**
+ * Sorts small and all-equal arrays with insertion sort turned off and
+ * three-way partitioning forced, so partitions see ranges down to a
+ * single element, with both quicksorts.
+ * @return Whether every array came out sorted.
+ */
+bool checkEdgeCases()
+{
+    Introsort::Settings settings;
+    settings.insertionCutoff = 0;
+    settings.duplicateThreshold = -1;
+    Introsort::setSettings(settings);
+
+    bool ok = true;
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> dist(-3, 3);
+    for(int sz = 1; sz <= 64; sz++)
+    {
+        for(int equal = 0; equal < 2; equal++)
+        {
+            int *arr = new int[sz];
+            int *arr1 = new int[sz];
+            for(int i = 0; i < sz; i++) { arr[i] = arr1[i] = equal ? 5 : dist(gen); }
+
+            SequentialQuickSort::quickSort(arr, 0, sz - 1);
+#pragma omp parallel default(none) shared(arr1, sz)
+            {
+#pragma omp single
+                ParallelQuickSort::quickSort(arr1, 0, sz - 1);
+            }
+            if(!isSorted(arr, sz) || !isSorted(arr1, sz)) {
+                std::cerr << "Not sorted: size " << sz << (equal ? ", all equal" : "") << std::endl;
+                ok = false;
+            }
+            delete[](arr);
+            delete[](arr1);
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+
+    // Edge cases of the partitions, see checkEdgeCases().
+    if(argc == 2 && std::string(argv[1]) == "--check") {
+        bool ok = checkEdgeCases();
+        std::cout << std::boolalpha << "Edge cases sorted: " << ok << std::endl;
+        return ok ? 0 : 1;
+    }
+
+    options opts;
+    if(!parseOptions(argc, argv, opts))
+    {
+        std::cerr << "Usage: Quicksort.exe --check | [--sorts sequential,parallel,radix] [--radix-bits 8|11] [--output results.csv]"
+                  << " [--insertion-cutoff n] [--task-cutoff n] [--ninther-threshold n]"
+                  << " [--parallel-threshold n] [--depth-factor n] [--partition lomuto|block]"
+                  << " [--duplicate-threshold r]" << std::endl;
+        return 1;
+    }
+    Introsort::setSettings(opts.settings);
 
     int max_sz = 1000*1000*10; // 10 Million
     int loopIncrement = 100;
@@ -109,41 +231,66 @@ int main() {
         }
         std::cout << "Sorting Size: " << sz << std::endl;
 
+        if(opts.sequential)
+        {
+            int *arr = randomArray(sz, -1000, 1000);
+            // Sampled the same way the sorts decide on three-way partitioning.
+            double duplicates = Introsort::duplicateRatio(arr, 0, sz - 1);
+            std::cout << "Duplicate ratio: " << duplicates << std::endl;
+            auto start = omp_get_wtime();
 
-        int *arr = randomArray(sz, -1000, 1000);
-        auto start = omp_get_wtime();
-
-        SequentialQuickSort::quickSort(arr, 0, sz - 1);
+            SequentialQuickSort::quickSort(arr, 0, sz - 1);
 
-        auto stop = omp_get_wtime();
-        auto duration = stop - start;
-        std::cout << "Time taken by Sequential function: " << duration << " seconds" << std::endl;
-        bool seq = isSorted(arr, sz);
-        //writeCSV(taskData{"sequential", duration, sz, seq});
+            auto stop = omp_get_wtime();
+            auto duration = stop - start;
+            std::cout << "Time taken by Sequential function: " << duration << " seconds" << std::endl;
+            bool seq = isSorted(arr, sz);
+            std::cout << std::boolalpha << "Sequential Sorted: " << seq << std::endl;
+            if(!opts.output.empty()) { writeCSV(opts.output, taskData{"sequential", duration, sz, seq, duplicates}); }
+            delete[](arr);
+        }
 
-        int *arr1 = randomArray(sz, -1000, 1000);
+        if(opts.parallel)
+        {
+            int *arr1 = randomArray(sz, -1000, 1000);
+            double duplicates1 = Introsort::duplicateRatio(arr1, 0, sz - 1);
+            std::cout << "Duplicate ratio: " << duplicates1 << std::endl;
 
-        start = omp_get_wtime();
+            auto start = omp_get_wtime();
 #pragma omp parallel default(none) shared(arr1, sz)
-        {
+            {
 #pragma omp single
-            ParallelQuickSort::quickSort(arr1, 0, sz - 1);
-        }
-
-        stop = omp_get_wtime();
-        duration = stop - start;
-        std::cout << "Time taken by Parallel function: " << duration << " seconds" << std::endl;
-        bool par = isSorted(arr1, sz);
+                ParallelQuickSort::quickSort(arr1, 0, sz - 1);
+            }
 
-        //writeCSV(taskData{"parallel", duration, sz, par});
+            auto stop = omp_get_wtime();
+            auto duration = stop - start;
+            std::cout << "Time taken by Parallel function: " << duration << " seconds" << std::endl;
+            bool par = isSorted(arr1, sz);
+            std::cout << std::boolalpha << "Parallel Sorted: " << par << std::endl;
+            if(!opts.output.empty()) { writeCSV(opts.output, taskData{"parallel", duration, sz, par, duplicates1}); }
+            delete[](arr1);
+        }
 
+        // Radix sort does not compare keys, so duplicates make no difference to it.
+        if(opts.radix)
+        {
+            int *arr2 = randomArray(sz, -1000, 1000);
+            double duplicates2 = Introsort::duplicateRatio(arr2, 0, sz - 1);
+            std::cout << "Duplicate ratio: " << duplicates2 << std::endl;
 
+            auto start = omp_get_wtime();
 
-        std::cout << std::boolalpha << "Sequential Sorted: " << seq << std::endl;
-        std::cout << std::boolalpha << "Parallel Sorted: " << par << std::endl;
+            RadixSort::sort(arr2, 0, sz - 1, opts.radixBits);
 
-        delete[](arr);
-        delete[](arr1);
+            auto stop = omp_get_wtime();
+            auto duration = stop - start;
+            std::cout << "Time taken by Radix function: " << duration << " seconds" << std::endl;
+            bool radix = isSorted(arr2, sz);
+            std::cout << std::boolalpha << "Radix Sorted: " << radix << std::endl;
+            if(!opts.output.empty()) { writeCSV(opts.output, taskData{"radix", duration, sz, radix, duplicates2}); }
+            delete[](arr2);
+        }
     } // End For Loop
     return 0;
 }
@@ -7,6 +7,7 @@
 #include <thread>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <mpi.h>
 
 /**
@@ -65,6 +66,31 @@ std::vector<int> initArray(const int rows, const int cols)
     std::vector<int> arr(rows * cols);
     return arr;
 }
+/**
+ * Transpose a square matrix in 32 x 32 blocks, so both the reads and the
+ * writes of a block stay in cache.
+ * @param src: The matrix to transpose.
+ * @param dst: Receives the transpose, same size as src.
+ * @param size: of the matrix.
+ */
+void transposeMatrix(const std::vector<int> &src, std::vector<int> &dst, int size)
+{
+    const int block = 32;
+    for(int ii = 0; ii < size; ii += block)
+    {
+        for(int jj = 0; jj < size; jj += block)
+        {
+            for(int i = ii; i < std::min(ii + block, size); i++)
+            {
+                for(int j = jj; j < std::min(jj + block, size); j++)
+                {
+                    dst[i * size + j] = src[j * size + i];
+                }
+            }
+        }
+    }
+}
+
 /**
  * Function to write data to CSV.
  * @param filename:  Name of file to write to.
@@ -116,6 +142,9 @@ int main(int argc, char **argv)
     {
         size = std::stoi(argv[1]);
     }
+    // With --transposed v2 is sent transposed, so the inner loop reads both
+    // operands with unit stride instead of striding down a column of v2.
+    const bool transposed = argc > 2 && std::string(argv[2]) == "--transposed";
 
     int worldRank, worldSize;
     MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
@@ -165,8 +194,15 @@ int main(int argc, char **argv)
     // this by using .data(). We use MPI_Scatterv as each process will receive a different number of elements.
     MPI_Scatterv(v1.data(), sendCounts.data(), displs.data(), MPI_INT,
                  v1_sub.data(), sendCounts[worldRank], MPI_INT, 0, MPI_COMM_WORLD);
-    // v2 will be used by all processes, so we need to broadcast it.
-    MPI_Bcast(v2.data(), size * size, MPI_INT, 0, MPI_COMM_WORLD);
+    // v2 will be used by all processes, so we need to broadcast it. The root keeps v2 as is for checking the
+    // result and broadcasts the transpose instead when asked to.
+    std::vector<int> v2t;
+    if(transposed) {
+        v2t.resize(size * size);
+        if(worldRank == 0) { transposeMatrix(v2, v2t, size); }
+    }
+    std::vector<int> &operand = transposed ? v2t : v2;
+    MPI_Bcast(operand.data(), size * size, MPI_INT, 0, MPI_COMM_WORLD);
 
     // Multiplication
     for(int i = 0; i < sendCounts[worldRank] / size; i++)
@@ -174,6 +210,16 @@ int main(int argc, char **argv)
         for(int j = 0; j < size; j++)
         {
             v3_sub[i * size + j] = 0;
+            if(transposed) {
+                // Row i of v1 against row j of v2 transposed, both contiguous.
+                int sum = 0;
+                for(int k = 0; k < size; k++)
+                {
+                    sum += v1_sub[i * size + k] * v2t[j * size + k];
+                }
+                v3_sub[i * size + j] = sum;
+                continue;
+            }
             for(int k = 0; k < size; k++)
             {
                 v3_sub[i * size + j] += v1_sub[i * size + k] * v2[k * size + j];
@@ -208,7 +254,7 @@ int main(int argc, char **argv)
                 }
             }
         }
-        writeToCSV("mpi_results.csv", "mpi", size, duration.count(), sorted);
+        writeToCSV("mpi_results.csv", transposed ? "mpi_transposed" : "mpi", size, duration.count(), sorted);
     }
     MPI_Finalize();
     return 0;
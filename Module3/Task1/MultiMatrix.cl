@@ -32,4 +32,30 @@ __kernel void matrixMul(const int maxRow, const int maxCol,
     //printf("Kernel process index :(%d,%d)\n1d index in C: %d\nres: %d\n", i, j, i * maxCol + j, res);
     //printf("res: %d\n", res);
     v3[i * maxCol + j] = res;
-}
\ No newline at end of file
+}
+
+/**
+ * Same as matrixMul, but v2 is given transposed, so the loop over k reads
+ * row i of v1 and row j of v2t, both with unit stride.
+ * @param   maxRow  The maximum number of rows in the input matrices.
+ * @param   maxCol  The maximum number of columns in the input matrices.
+ * @param   v1      Pointer to the first input matrix, represented as a 1D array.
+ * @param   v2t     Pointer to the transpose of the second input matrix, represented as a 1D array.
+ * @param   v3      Pointer to the output matrix, where the result will be stored, represented as a 1D array.
+ */
+__kernel void matrixMulTransposed(const int maxRow, const int maxCol,
+                      const __global int* v1,const __global int* v2t,__global int* v3) {
+
+    const int i = get_global_id(0);
+    const int j = get_global_id(1);
+
+    if(i > maxRow - 1 || j > maxCol - 1) { return; }
+
+    // v2t[j * maxCol + k] is the element in the k-th row and j-th column of the original v2.
+    int res = 0;
+    for(int k = 0; k < maxCol; k++)
+    {
+        res += v1[i * maxCol + k] * v2t[j * maxCol + k];
+    }
+    v3[i * maxCol + j] = res;
+}
@@ -11,6 +11,7 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <mpi.h>
 #include <omp.h>
 
@@ -73,6 +74,32 @@ std::vector<int> initArray(const int rows, const int cols)
     return arr;
 }
 
+/**
+ * Transpose a square matrix in 32 x 32 blocks, so both the reads and the
+ * writes of a block stay in cache.
+ * @param src: The matrix to transpose.
+ * @param dst: Receives the transpose, same size as src.
+ * @param size: of the matrix.
+ */
+void transposeMatrix(const std::vector<int> &src, std::vector<int> &dst, int size)
+{
+    const int block = 32;
+#pragma omp parallel for default(none) shared(src, dst) firstprivate(size, block)
+    for(int ii = 0; ii < size; ii += block)
+    {
+        for(int jj = 0; jj < size; jj += block)
+        {
+            for(int i = ii; i < std::min(ii + block, size); i++)
+            {
+                for(int j = jj; j < std::min(jj + block, size); j++)
+                {
+                    dst[i * size + j] = src[j * size + i];
+                }
+            }
+        }
+    }
+}
+
 /**
  * Function to write data to CSV.
  * @param filename:  Name of file to write to.
@@ -124,6 +151,9 @@ int main(int argc, char **argv)
     {
         size = std::stoi(argv[1]);
     }
+    // With --transposed v2 is sent transposed, so the inner loop reads both
+    // operands with unit stride instead of striding down a column of v2.
+    const bool transposed = argc > 2 && std::string(argv[2]) == "--transposed";
 
     int worldRank, worldSize;
     MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
@@ -172,25 +202,50 @@ int main(int argc, char **argv)
     // this by using .data(). We use MPI_Scatterv as each process will receive a different number of elements.
     MPI_Scatterv(v1.data(), sendCounts.data(), displs.data(), MPI_INT,
                  v1_sub.data(), sendCounts[worldRank], MPI_INT, 0, MPI_COMM_WORLD);
-    // v2 will be used by all processes, so we need to broadcast it.
-    MPI_Bcast(v2.data(), size * size, MPI_INT, 0, MPI_COMM_WORLD);
-
-    // We use OMP here to speed up the multiplication. We use a number of threads equal to world size, and we also
-    // use collapse to make the 2 outer-loops one.
+    // v2 will be used by all processes, so we need to broadcast it. The root keeps v2 as is for checking the
+    // result and broadcasts the transpose instead when asked to.
+    std::vector<int> v2t;
+    if(transposed) {
+        v2t.resize(size * size);
+        if(worldRank == 0) { transposeMatrix(v2, v2t, size); }
+    }
+    std::vector<int> &operand = transposed ? v2t : v2;
+    MPI_Bcast(operand.data(), size * size, MPI_INT, 0, MPI_COMM_WORLD);
+
+    // Against v2 transposed every element is a dot product of two contiguous rows, kept in a private sum.
+    if(transposed) {
+        const int rows = sendCounts[worldRank] / size;
+#pragma omp parallel for default(none) shared(v1_sub, v2t, v3_sub) firstprivate(size, rows) num_threads(worldSize) collapse(2) schedule(auto)
+        for(int i = 0; i < rows; i++)
+        {
+            for(int j = 0; j < size; j++)
+            {
+                int dot = 0;
+                for(int k = 0; k < size; k++)
+                {
+                    dot += v1_sub[i * size + k] * v2t[j * size + k];
+                }
+                v3_sub[i * size + j] = dot;
+            }
+        }
+    } else {
+        // We use OMP here to speed up the multiplication. We use a number of threads equal to world size, and we also
+        // use collapse to make the 2 outer-loops one.
 #pragma omp parallel for default(none) shared(v1_sub, v2, v3_sub, sum) firstprivate(size, sendCounts, worldRank) num_threads(worldSize) collapse(2) schedule(auto)
-    for(int i = 0; i < sendCounts[worldRank] / size; i++)
-    {
-        for(int j = 0; j < size; j++)
+        for(int i = 0; i < sendCounts[worldRank] / size; i++)
         {
-            sum = 0;
-            // We then use a parallel reduction section on sum to calculate the work, and then assign it to the
-            // appropriate position in the results.
-#pragma omp parallel reduction(+:sum)
-            for(int k = 0; k < size; k++)
+            for(int j = 0; j < size; j++)
             {
-                sum += v1_sub[i * size + k] * v2[k * size + j];
+                sum = 0;
+                // We then use a parallel reduction section on sum to calculate the work, and then assign it to the
+                // appropriate position in the results.
+#pragma omp parallel reduction(+:sum)
+                for(int k = 0; k < size; k++)
+                {
+                    sum += v1_sub[i * size + k] * v2[k * size + j];
+                }
+                v3_sub[i * size + j] = sum;
             }
-            v3_sub[i * size + j] = sum;
         }
     }
 
@@ -227,7 +282,7 @@ int main(int argc, char **argv)
                 }
             }
         }
-        writeToCSV("omp_mpi_results.csv", "omp_mpi", size, duration.count(), sorted);
+        writeToCSV("omp_mpi_results.csv", transposed ? "omp_mpi_transposed" : "omp_mpi", size, duration.count(), sorted);
 
     }
     MPI_Finalize();
@@ -9,6 +9,7 @@
 #include <vector>
 #include <thread>
 #include <random>
+#include <algorithm>
 #include <mpi.h>
 #include <CL/cl.h>
 
@@ -83,6 +84,31 @@ bool writeToCSV(const std::string& filename,
     file.close();
     return true;
 }
+/**
+ * Transpose a square matrix in 32 x 32 blocks, so both the reads and the
+ * writes of a block stay in cache.
+ * @param src: The matrix to transpose.
+ * @param dst: Receives the transpose, same size as src.
+ * @param size: of the matrix.
+ */
+void transposeMatrix(const std::vector<int> &src, std::vector<int> &dst, int size)
+{
+    const int block = 32;
+    for(int ii = 0; ii < size; ii += block)
+    {
+        for(int jj = 0; jj < size; jj += block)
+        {
+            for(int i = ii; i < std::min(ii + block, size); i++)
+            {
+                for(int j = jj; j < std::min(jj + block, size); j++)
+                {
+                    dst[i * size + j] = src[j * size + i];
+                }
+            }
+        }
+    }
+}
+
 /**
  * Initialize a 1D vector for matrix of given rows and cols.
  * @param rows: of the matrix.
@@ -144,6 +170,9 @@ int main(int argc, char **argv) {
     MPI_Init(&argc, &argv);
     if (argc > 1)
         SZ = atoi(argv[1]);
+    // With --transposed v2 is sent transposed and the matrixMulTransposed
+    // kernel reads both operands along rows.
+    const bool transposed = argc > 2 && std::string(argv[2]) == "--transposed";
 
     // Setting global and local work sizes.
     global[0] = SZ;
@@ -202,13 +231,21 @@ int main(int argc, char **argv) {
     // this by using .data(). We use MPI_Scatterv as each process will receive a different number of elements.
     MPI_Scatterv(v1.data(), sendCounts.data(), displs.data(), MPI_INT,
                  v1_sub.data(), sendCounts[worldRank], MPI_INT, 0, MPI_COMM_WORLD);
-    // v2 will be used by all processes, so we need to broadcast it.
-    MPI_Bcast(v2.data(), SZ * SZ, MPI_INT, 0, MPI_COMM_WORLD);
+    // v2 will be used by all processes, so we need to broadcast it. The root keeps v2 as is for checking the
+    // result and broadcasts the transpose instead when asked to.
+    std::vector<int> v2t;
+    if (transposed) {
+        v2t.resize(SZ * SZ);
+        if (worldRank == 0) { transposeMatrix(v2, v2t, SZ); }
+    }
+    std::vector<int> &operand = transposed ? v2t : v2;
+    MPI_Bcast(operand.data(), SZ * SZ, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Barrier(MPI_COMM_WORLD);
 
     // Setup the matrix OpenCL program and the kernel for each process.
-    setup_openCL_device_context_queue_kernel((char *) "./MultiMatrix.cl", (char *) "matrixMul");
-    setup_kernel_memory(worldRank,  v1_sub, v2, v3_sub);
+    setup_openCL_device_context_queue_kernel((char *) "./MultiMatrix.cl",
+                                             (char *) (transposed ? "matrixMulTransposed" : "matrixMul"));
+    setup_kernel_memory(worldRank,  v1_sub, operand, v3_sub);
     copy_kernel_args(sendCounts[worldRank] / SZ, worldRank);
 
     err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global, NULL, 0, NULL, &event);
@@ -253,7 +290,7 @@ int main(int argc, char **argv) {
                 }
             }
         }
-        writeToCSV("output.csv", "OpenCL", SZ, duration.count(), sorted ? "true" : "false");
+        writeToCSV("output.csv", transposed ? "OpenCL_transposed" : "OpenCL", SZ, duration.count(), sorted ? "true" : "false");
     }
     MPI_Barrier(MPI_COMM_WORLD);
 